@@ -0,0 +1,31 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Property reads of typed test server objects through accessors and through the interceptor
+// Usage: node bench/accessors.js [reads]
+//-------------------------------------------------------------------------------------------------------
+
+var winax = require('../activex');
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+var reads = parseInt(process.argv[2]) || 10000000;
+var spec = { properties: { Value: 1, Name: 'name', Count: 2, Flag: true }, typeInfo: '{0F3E8B52-2C1A-4D7E-B6A4-8E5D9C0B1A23}', eager: true };
+
+function run(accessors) {
+    winax.configure({ accessors: accessors });
+    var srv = winax.testServer(spec), v = 0;
+    for (var w = 0; w < 10000; w++) v += srv.Value;
+    var t = now();
+    for (var i = 0; i < reads; i++) v += srv.Value;
+    var ns = (now() - t) / reads;
+    winax.release(srv);
+    return ns;
+}
+
+var interceptor = run(false), accessor = run(true);
+console.log('interceptor: ' + interceptor.toFixed(1) + ' ns/read, accessor: ' + accessor.toFixed(1) + ' ns/read, speedup ' +
+    (interceptor / accessor).toFixed(2) + 'x');
+winax.configure({ accessors: true });
@@ -0,0 +1,35 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Asynchronous call throughput and queue latency for objects in main and dedicated apartments
+// Usage: node bench/apartments.js [objects] [calls]
+//-------------------------------------------------------------------------------------------------------
+
+var winax = require('../activex');
+
+var objects = parseInt(process.argv[2]) || 4, calls = parseInt(process.argv[3]) || 2000;
+
+// In-process server with a trivial method, so the numbers show dispatching costs
+function run(apartment) {
+    var dicts = [];
+    for (var i = 0; i < objects; i++) {
+        var dict = new ActiveXObject('Scripting.Dictionary', { apartment: apartment });
+        dict.Add('key', i);
+        dicts.push(dict);
+    }
+    winax.stats(true);
+    var t = process.hrtime(), pending = [];
+    for (var c = 0; c < calls; c++) {
+        pending.push(winax.callAsync(dicts[c % objects], 'Exists', 'key'));
+    }
+    return Promise.all(pending).then(function() {
+        var dt = process.hrtime(t), ms = dt[0] * 1e3 + dt[1] / 1e6;
+        var apt = winax.stats().apartments;
+        console.log(apartment + ': ' + calls + ' calls on ' + objects + ' objects ' + ms.toFixed(1) + ' ms, ' +
+            Math.round(calls * 1000 / ms) + ' calls/s, queue latency ' +
+            (apt.jobs ? (apt.queueTime / apt.jobs).toFixed(1) + ' us' : '-') + ', threads ' + apt.threads);
+        winax.release.apply(winax, dicts);
+    });
+}
+
+winax.configure({ apartmentThreads: objects });
+run('main').then(function() { return run('sta'); }).then(function() { return run('mta'); });
@@ -0,0 +1,30 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Micro benchmark of call() argument marshaling for 0-12 number and string arguments
+// Usage: node bench/arguments.js [calls]
+//-------------------------------------------------------------------------------------------------------
+
+require('../activex');
+
+var calls = parseInt(process.argv[2]) || 100000;
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+// JS object server keeps the callee cheap, so the numbers show argument conversion costs
+var com_obj = new ActiveXObject({ f: function() { return 0; } });
+var func = com_obj.f, apply = Function.prototype.apply;
+
+[0, 1, 4, 8, 12].forEach(function(argcnt) {
+    [['number', 1.5], ['string', 'value']].forEach(function(kind) {
+        var args = [];
+        for (var i = 0; i < argcnt; i++) args.push(kind[1]);
+        apply.call(func, null, args);
+        var t = now();
+        for (var c = 0; c < calls; c++) apply.call(func, null, args);
+        var ns = (now() - t) / calls;
+        console.log('arguments: ' + argcnt + ' ' + kind[0] + ', ' + ns.toFixed(0) + ' ns/call');
+    });
+});
@@ -0,0 +1,42 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Wrapper allocations per iteration for child objects (rs.Fields) with and without cache
+// Usage: node --expose-gc bench/children.js
+//-------------------------------------------------------------------------------------------------------
+
+require('../activex');
+
+var rows = 100, passes = 200;
+
+function createRecordset(opt) {
+    var rs = new ActiveXObject('ADODB.Recordset', opt);
+    rs.Fields.Append('Name', 200 /* adVarChar */, 50);
+    rs.Open();
+    for (var i = 0; i < rows; i++) {
+        rs.AddNew();
+        rs.Fields('Name').Value = 'Name' + i;
+        rs.Update();
+    }
+    return rs;
+}
+
+[{ cache: false }, { cache: true }].forEach(function(opt) {
+    var rs = createRecordset(opt);
+    if (global.gc) global.gc();
+    var heap = process.memoryUsage().heapUsed;
+    var t = process.hrtime(), cnt = 0, same = 0, last;
+    for (var p = 0; p < passes; p++) {
+        rs.MoveFirst();
+        while (!rs.EOF) {
+            var fields = rs.Fields;
+            if (fields === last) same++;
+            last = fields;
+            rs.MoveNext();
+            cnt++;
+        }
+    }
+    t = process.hrtime(t);
+    var bytes = (process.memoryUsage().heapUsed - heap) / cnt;
+    console.log('cache: ' + opt.cache + ', ' + ((t[0] * 1e9 + t[1]) / cnt).toFixed(0) + ' ns/iteration, heap growth: ' +
+        bytes.toFixed(1) + ' bytes/iteration, same wrapper: ' + same + '/' + cnt);
+});
@@ -0,0 +1,113 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: End-to-end throughput of property reads, writes, method calls, indexes and chains of the test server
+// Usage: node --expose-gc bench/dispatch.js [--ops N] [--save file] [--baseline file] [--tolerance percent]
+//-------------------------------------------------------------------------------------------------------
+
+var fs = require('fs');
+var winax = require('../activex');
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+function option(name, def) {
+    var i = process.argv.indexOf('--' + name);
+    return (i >= 0 && i + 1 < process.argv.length) ? process.argv[i + 1] : def;
+}
+
+var ops = parseInt(option('ops')) || 200000;
+var save = option('save'), baseline = option('baseline');
+var tolerance = parseFloat(option('tolerance')) || 10;
+
+// Operations are timed by batches, single calls are too short for the timer resolution
+var batch = 32;
+
+function collect() {
+    if (global.gc) global.gc();
+}
+
+function percentile(sorted, p) {
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+function measure(name, op) {
+    for (var w = 0; w < 10000; w++) op(w);
+    collect();
+    var heap = process.memoryUsage().heapUsed;
+    var samples = [], total = 0;
+    for (var done = 0; done < ops; done += batch) {
+        var t = now();
+        for (var i = 0; i < batch; i++) op(done + i);
+        var dt = now() - t;
+        samples.push(dt / batch);
+        total += dt;
+    }
+    // Growth left without collection shows garbage produced by wrappers, after collection - leaks
+    var garbage = process.memoryUsage().heapUsed - heap;
+    collect();
+    var retained = process.memoryUsage().heapUsed - heap;
+    samples.sort(function(a, b) { return a - b; });
+    var count = samples.length * batch;
+    return {
+        name: name,
+        ops: count,
+        opsPerSec: Math.round(count * 1e9 / total),
+        p50: Math.round(percentile(samples, 0.5)),
+        p99: Math.round(percentile(samples, 0.99)),
+        heapPerOp: Math.round(garbage / count),
+        retainedPerOp: global.gc ? Math.round(retained / count) : undefined
+    };
+}
+
+var results = [];
+[false, true].forEach(function(typed) {
+    var d = winax.testServer({ properties: { D: 1 }, typeInfo: typed });
+    var c = winax.testServer({ properties: { C: d }, typeInfo: typed });
+    var b = winax.testServer({ properties: { B: c }, typeInfo: typed });
+    var obj = winax.testServer({
+        properties: { Prop: 1, Text: 'text', Child: b },
+        methods: { Method: null },
+        items: [0, 1, 2, 3, 4, 5, 6, 7],
+        typeInfo: typed
+    });
+    var suffix = typed ? ' (typed)' : '';
+    results.push(measure('obj.Prop' + suffix, function() { return obj.Prop; }));
+    results.push(measure('obj.Text' + suffix, function() { return obj.Text; }));
+    results.push(measure('obj.Method(a, b)' + suffix, function(i) { return obj.Method(i, 'b'); }));
+    results.push(measure('obj[3]' + suffix, function() { return obj[3]; }));
+    results.push(measure('obj.Prop = x' + suffix, function(i) { obj.Prop = i; }));
+    results.push(measure('obj.Child.B.C.D' + suffix, function() { return obj.Child.B.C.D; }));
+    winax.release(obj, b, c, d);
+});
+
+function pad(text, width) {
+    text = String(text);
+    while (text.length < width) text = ' ' + text;
+    return text;
+}
+
+console.log(pad('operation', 28) + pad('ops/sec', 12) + pad('p50 ns', 10) + pad('p99 ns', 10) + pad('heap B/op', 11) + pad('kept B/op', 11));
+results.forEach(function(r) {
+    console.log(pad(r.name, 28) + pad(r.opsPerSec, 12) + pad(r.p50, 10) + pad(r.p99, 10) + pad(r.heapPerOp, 11) +
+        pad(r.retainedPerOp === undefined ? '-' : r.retainedPerOp, 11));
+});
+if (!global.gc) console.log('run with --expose-gc to separate garbage from retained memory');
+
+if (save) fs.writeFileSync(save, JSON.stringify({ node: process.version, arch: process.arch, results: results }, null, 2));
+
+// Compare with saved results, slower operations fail the run
+if (baseline) {
+    var base = JSON.parse(fs.readFileSync(baseline, 'utf8')).results, failed = 0;
+    base.forEach(function(b) {
+        var r = results.filter(function(r) { return r.name == b.name; })[0];
+        if (!r) return;
+        var change = (r.opsPerSec / b.opsPerSec - 1) * 100;
+        if (change < -tolerance) {
+            console.log('regression: ' + r.name + ' ' + change.toFixed(1) + '% (' + b.opsPerSec + ' -> ' + r.opsPerSec + ' ops/sec)');
+            failed++;
+        }
+    });
+    if (failed) process.exitCode = 1;
+}
@@ -0,0 +1,38 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Micro benchmark of member name and DISPID tables (build and lookup cost)
+// Usage: node bench/names.js
+//-------------------------------------------------------------------------------------------------------
+
+require('../activex');
+
+var sizes = [50, 500, 5000];
+var passes = 20;
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+sizes.forEach(function(size) {
+    var js_obj = {}, names = [];
+    for (var i = 0; i < size; i++) {
+        names.push('Member' + i);
+        js_obj[names[i]] = i;
+    }
+    var com_obj = new ActiveXObject(js_obj);
+
+    // First pass fills both name tables (DispInfo names cache and DispObjectImpl names/index)
+    var t = now(), sum = 0;
+    for (var i = 0; i < size; i++) sum += com_obj[names[i]].valueOf();
+    var build = (now() - t) / size;
+
+    // Next passes are pure lookups
+    t = now();
+    for (var p = 0; p < passes; p++) {
+        for (var i = 0; i < size; i++) sum += com_obj[names[i]].valueOf();
+    }
+    var lookup = (now() - t) / (size * passes);
+
+    console.log('members: ' + size + ', build: ' + build.toFixed(0) + ' ns/member, lookup: ' + lookup.toFixed(0) + ' ns/member');
+});
@@ -0,0 +1,23 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Native conversion and dispatch timings measured inside the addon, printed as JSON
+// Usage: node bench/native.js [file] [iterations] [suite ...]
+//-------------------------------------------------------------------------------------------------------
+
+var fs = require('fs');
+var winax = require('../activex');
+
+var file = process.argv[2];
+var iterations = parseInt(process.argv[3]) || 100000;
+var suites = process.argv.slice(4);
+
+var report = {
+    node: process.version,
+    arch: process.arch,
+    iterations: iterations,
+    results: winax.benchmark({ iterations: iterations, suites: suites.length ? suites : undefined })
+};
+
+var text = JSON.stringify(report, null, 2);
+if (file && file != '-') fs.writeFileSync(file, text);
+else console.log(text);
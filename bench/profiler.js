@@ -0,0 +1,35 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Overhead of the call profiler on calls of a JS object server (cheapest dispatch calls)
+// Usage: node bench/profiler.js [calls]
+//-------------------------------------------------------------------------------------------------------
+
+var winax = require('../activex');
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+var calls = parseInt(process.argv[2]) || 500000;
+var com_obj = new ActiveXObject({ inc: function(v) { return v + 1; } });
+
+function run(profile) {
+    winax.configure({ profile: profile });
+    winax.stats(true);
+    var inc = com_obj.inc, t = now(), v = 0;
+    for (var c = 0; c < calls; c++) v = inc(v);
+    return (now() - t) / calls;
+}
+
+// Alternate runs so that both modes see the same warm-up and machine noise
+var off = [], on = [];
+for (var i = 0; i < 5; i++) {
+    off.push(run(false));
+    on.push(run(true));
+}
+var best_off = Math.min.apply(Math, off), best_on = Math.min.apply(Math, on);
+console.log('profile off: ' + best_off.toFixed(0) + ' ns/call, on: ' + best_on.toFixed(0) + ' ns/call, overhead ' +
+    ((best_on / best_off - 1) * 100).toFixed(1) + '%');
+console.log(JSON.stringify(winax.stats().members));
+winax.configure({ profile: false });
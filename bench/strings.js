@@ -0,0 +1,29 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: String marshaling round trip (JS -> BSTR -> JS -> BSTR -> JS) for short and very long strings
+// Usage: node bench/strings.js
+//-------------------------------------------------------------------------------------------------------
+
+require('../activex');
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+// JS object server returns its argument, each call converts the string four times
+var com_obj = new ActiveXObject({ echo: function(s) { return s; } });
+var echo = com_obj.echo;
+
+function run(title, strings, calls) {
+    var t = now(), len = 0;
+    for (var c = 0; c < calls; c++) len += echo(strings[c % strings.length]).length;
+    var ns = (now() - t) / calls;
+    console.log(title + ': ' + calls + ' calls, ' + ns.toFixed(0) + ' ns/call, ' + (len / calls).toFixed(0) + ' chars/call');
+}
+
+var names = ['Name', 'City', 'Phone', 'Zip', 'ADODB.Connection', 'Excel.Application'];
+run('short repeated', names, 1000000);
+
+var long = [new Array(1024 * 1024 + 1).join('x'), new Array(512 * 1024 + 1).join('ф')];
+run('long (1M and 512K chars)', long, 1000);
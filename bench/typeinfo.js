@@ -0,0 +1,52 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Counts type info function descriptions loaded per property access (lazy and eager modes)
+// Usage: node bench/typeinfo.js
+//-------------------------------------------------------------------------------------------------------
+
+var winax = require('../activex');
+
+var iterations = 1000;
+
+function createRecordset(opt) {
+    var rs = new ActiveXObject('ADODB.Recordset', opt);
+    rs.Fields.Append('Name', 200 /* adVarChar */, 50);
+    rs.Fields.Append('Zip', 3 /* adInteger */);
+    rs.Open();
+    for (var i = 0; i < 10; i++) {
+        rs.AddNew();
+        rs.Fields('Name').Value = 'Name' + i;
+        rs.Fields('Zip').Value = i;
+        rs.Update();
+    }
+    return rs;
+}
+
+[{ eager: false }, { eager: true }].forEach(function(opt) {
+    var rs = createRecordset(opt);
+    winax.stats(true);
+    var t = process.hrtime(), cnt = 0;
+    for (var i = 0; i < iterations; i++) {
+        rs.MoveFirst();
+        while (!rs.EOF) {
+            var fields = rs.Fields;
+            var name = fields('Name').Value;
+            var zip = fields('Zip').Value;
+            rs.MoveNext();
+            cnt++;
+        }
+    }
+    t = process.hrtime(t);
+    var stats = winax.stats();
+    var ms = t[0] * 1e3 + t[1] / 1e6;
+    console.log((opt.eager ? 'eager' : 'lazy ') + ': ' + (stats.funcdesc / cnt).toFixed(2) + ' GetFuncDesc/row, ' + (ms * 1e3 / cnt).toFixed(2) + ' us/row');
+});
+
+// Shared type descriptions: many recordsets of the same interface load members once
+winax.stats(true);
+for (var i = 0; i < 100; i++) {
+    var rs = createRecordset({ eager: true });
+    rs.Close();
+}
+var stats = winax.stats();
+console.log('type cache: ' + JSON.stringify(stats.typeCache) + ', GetFuncDesc: ' + stats.funcdesc);
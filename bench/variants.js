@@ -0,0 +1,37 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: node-activex
+// Description: Scalar VARIANT conversion throughput, rows of all numeric field types fetched from in-memory recordset
+// Usage: node bench/variants.js [rows]
+//-------------------------------------------------------------------------------------------------------
+
+var winax = require('../activex');
+
+function now() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+var rows = parseInt(process.argv[2]) || 20000;
+
+// Field types: adTinyInt, adSmallInt, adInteger, adUnsignedTinyInt, adUnsignedSmallInt, adUnsignedInt, adSingle, adDouble, adCurrency, adBoolean
+var types = [16, 2, 3, 17, 18, 19, 4, 5, 6, 11];
+var rs = new ActiveXObject('ADODB.Recordset');
+types.forEach(function(type, i) { rs.Fields.Append('f' + i, type); });
+rs.Open();
+var names = types.map(function(type, i) { return 'f' + i; });
+for (var r = 0; r < rows; r++) {
+    rs.AddNew(names, types.map(function(type) { return (type == 11) ? (r % 2 == 0) : (r % 100); }));
+}
+rs.Update();
+
+function run(title, options) {
+    rs.MoveFirst();
+    var t = now(), data = winax.fetchRows(rs, options);
+    var ns = (now() - t) / (rows * types.length);
+    console.log(title + ': ' + rows + ' rows, ' + ns.toFixed(1) + ' ns/value');
+    return data;
+}
+
+run('rows', {});
+run('columns', { columnar: true });
+rs.Close();
@@ -5,7 +5,13 @@
       'sources': [
         'src/main.cpp',
         'src/utils.cpp',
-        'src/disp.cpp'
+        'src/disp.cpp',
+        'src/async.cpp',
+        'src/apartment.cpp',
+        'src/enum.cpp',
+        'src/profiler.cpp',
+        'src/server.cpp',
+        'src/bench.cpp'
       ],
       'dependencies': [
       ]
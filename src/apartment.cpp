@@ -0,0 +1,221 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispApartment class implementations
+//-------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "disp.h"
+
+std::vector<DispApartment*> DispApartment::sta_pool;
+DispApartment *DispApartment::mta = nullptr;
+ULONG DispApartment::sta_threads = 0;
+ULONG DispApartment::sta_next = 0;
+LONGLONG DispApartment::queue_ticks = 0;
+ULONGLONG DispApartment::jobs = 0;
+FlatMap<std::wstring, int, FlatHashNoCase, FlatEqualNoCase> DispApartment::kinds;
+
+//-------------------------------------------------------------------------------------------------------
+
+// Creates object in apartment thread, the job is owned by waiting thread
+struct DispCreateJob : public DispJob {
+	CLSID clsid;
+	bool activate;
+	HRESULT hrcode;
+	IStream *stream;
+	IDispatch *owned;
+	HANDLE done;
+
+	inline DispCreateJob(REFCLSID id, bool act) : clsid(id), activate(act), hrcode(E_FAIL), stream(nullptr), owned(nullptr), done(NULL) {}
+
+	virtual void Run() {
+		CComPtr<IDispatch> disp;
+		if (activate) {
+			CComPtr<IUnknown> unk;
+			hrcode = GetActiveObject(clsid, NULL, &unk);
+			if SUCCEEDED(hrcode) hrcode = unk->QueryInterface(&disp);
+		}
+		if FAILED(hrcode) {
+			hrcode = disp.CoCreateInstance(clsid, nullptr, CLSCTX_INPROC_SERVER | CLSCTX_LOCAL_SERVER);
+		}
+		if SUCCEEDED(hrcode) hrcode = CoMarshalInterThreadInterfaceInStream(IID_IDispatch, disp, &stream);
+		if SUCCEEDED(hrcode) owned = disp.Detach();
+		SetEvent(done);
+	}
+};
+
+struct DispReleaseJob : public DispJob {
+	IDispatch *ptr;
+	inline DispReleaseJob(IDispatch *disp) : ptr(disp) {}
+	virtual void Run() {
+		ptr->Release();
+		delete this;
+	}
+};
+
+//-------------------------------------------------------------------------------------------------------
+// DispJobQueue implemetation
+
+DispJobQueue::DispJobQueue() : head(&stub), tail(&stub) {
+}
+
+void DispJobQueue::Push(DispJob *job) {
+	job->next = nullptr;
+	DispJob *prev = (DispJob*)InterlockedExchangePointer((PVOID volatile*)&head, job);
+	prev->next = job;
+}
+
+DispJob *DispJobQueue::Pop() {
+	DispJob *first = tail, *next = first->next;
+	if (first == &stub) {
+		if (!next) return nullptr;
+		tail = next;
+		first = next;
+		next = next->next;
+	}
+	if (next) {
+		tail = next;
+		return first;
+	}
+
+	// Producer has not linked the next job yet, it signals again after Push
+	if (first != head) return nullptr;
+	Push(&stub);
+	next = first->next;
+	if (next) {
+		tail = next;
+		return first;
+	}
+	return nullptr;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispApartment implemetation
+
+DispApartment::DispApartment(kind_t knd) : kind(knd), thread(NULL) {
+	event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (event) thread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+}
+
+DWORD WINAPI DispApartment::ThreadProc(LPVOID param) {
+	DispApartment *self = (DispApartment*)param;
+	CoInitializeEx(0, (self->kind == apartment_mta) ? COINIT_MULTITHREADED : COINIT_APARTMENTTHREADED);
+
+	// Apartment threads live as long as the process
+	for (;;) {
+		MsgWaitForMultipleObjectsEx(1, &self->event, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		self->Process();
+		MSG msg;
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+	}
+}
+
+void DispApartment::Process() {
+	LARGE_INTEGER now;
+	while (DispJob *job = queue.Pop()) {
+		QueryPerformanceCounter(&now);
+		InterlockedExchangeAdd64(&queue_ticks, now.QuadPart - job->queued);
+		InterlockedIncrement64((LONGLONG*)&jobs);
+		job->Run();
+	}
+}
+
+void DispApartment::Post(DispJob *job) {
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	job->queued = now.QuadPart;
+	queue.Push(job);
+	SetEvent(event);
+}
+
+void DispApartment::Release(IDispatch *ptr) {
+	Post(new DispReleaseJob(ptr));
+}
+
+DispApartment *DispApartment::Get(kind_t kind) {
+	DispApartment *apt;
+	if (kind == apartment_mta) {
+		if (!mta) mta = new DispApartment(apartment_mta);
+		apt = mta;
+	}
+	else {
+		ULONG index = sta_next++ % GetThreads();
+		while (sta_pool.size() <= index) sta_pool.push_back(new DispApartment(apartment_sta));
+		apt = sta_pool[index];
+	}
+	return apt->thread ? apt : nullptr;
+}
+
+HRESULT DispApartment::CreateInstance(kind_t kind, REFCLSID clsid, bool activate, IDispatch **result, IDispatch **owned, DispApartment **apartment) {
+	DispApartment *apt = Get(kind);
+	if (!apt) return E_FAIL;
+	DispCreateJob job(clsid, activate);
+	job.done = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!job.done) return HRESULT_FROM_WIN32(GetLastError());
+	apt->Post(&job);
+
+	// Calling thread keeps serving its own apartment while waiting
+	DWORD index;
+	HRESULT hrcode = CoWaitForMultipleHandles(0, INFINITE, 1, &job.done, &index);
+	CloseHandle(job.done);
+	if SUCCEEDED(hrcode) hrcode = job.hrcode;
+	if SUCCEEDED(hrcode) hrcode = CoGetInterfaceAndReleaseStream(job.stream, IID_IDispatch, (void**)result);
+	if FAILED(hrcode) {
+		if (job.owned) apt->Release(job.owned);
+		return hrcode;
+	}
+	*owned = job.owned;
+	*apartment = apt;
+	return S_OK;
+}
+
+DispApartment::kind_t DispApartment::GetKind(const std::wstring &progid) {
+	const int *kind = kinds.find(progid);
+	return kind ? (kind_t)*kind : apartment_main;
+}
+
+void DispApartment::SetKind(const std::wstring &progid, kind_t kind) {
+	kinds[progid] = kind;
+}
+
+void DispApartment::SetThreads(ULONG cnt) {
+	sta_threads = cnt;
+}
+
+ULONG DispApartment::GetThreads() {
+	if (sta_threads == 0) {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		sta_threads = (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+	}
+	return sta_threads;
+}
+
+ULONG DispApartment::GetRunning() {
+	return (ULONG)sta_pool.size() + (mta ? 1 : 0);
+}
+
+ULONGLONG DispApartment::GetQueueTime() {
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	ULONGLONG ticks = (ULONGLONG)queue_ticks;
+	return (ticks / freq.QuadPart) * 1000000 + (ticks % freq.QuadPart) * 1000000 / freq.QuadPart;
+}
+
+// Counters are updated by apartment threads, so they are cleared atomically
+void DispApartment::ResetStats() {
+	InterlockedExchange64((LONGLONG*)&jobs, 0);
+	InterlockedExchange64(&queue_ticks, 0);
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispHome implemetation
+
+DispHome::~DispHome() {
+	if (apartment && ptr) apartment->Release(ptr);
+}
+
+//-------------------------------------------------------------------------------------------------------
@@ -0,0 +1,90 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispApartment class declarations. Dedicated apartment threads owning COM objects
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------
+// Job executed by apartment thread, Run is responsible for job lifetime
+
+struct DispJob {
+	DispJob *volatile next;
+	LONGLONG queued;
+	inline DispJob() : next(nullptr), queued(0) {}
+	virtual ~DispJob() {}
+	virtual void Run() {}
+};
+
+// Lock-free intrusive queue, many producers and single consumer
+class DispJobQueue {
+public:
+	DispJobQueue();
+	void Push(DispJob *job);
+	DispJob *Pop();
+
+private:
+	DispJob *volatile head;
+	DispJob *tail;
+	DispJob stub;
+};
+
+//-------------------------------------------------------------------------------------------------------
+
+class DispApartment {
+public:
+	enum kind_t { apartment_main = 0, apartment_sta, apartment_mta };
+
+	// Creates object by apartment thread, returns proxy for the calling thread and pointer owned by apartment
+	static HRESULT CreateInstance(kind_t kind, REFCLSID clsid, bool activate, IDispatch **result, IDispatch **owned, DispApartment **apartment);
+
+	// Apartment kind configured for ProgId
+	static kind_t GetKind(const std::wstring &progid);
+	static void SetKind(const std::wstring &progid, kind_t kind);
+
+	// Number of single threaded apartments used for new objects
+	static void SetThreads(ULONG cnt);
+	static ULONG GetThreads();
+
+	static ULONGLONG jobs;
+	static ULONGLONG GetQueueTime();	// total time jobs were waiting in queues, microseconds
+	static void ResetStats();
+	static ULONG GetRunning();
+
+	void Post(DispJob *job);
+	void Release(IDispatch *ptr);
+
+private:
+	DispApartment(kind_t knd);
+
+	kind_t kind;
+	HANDLE thread;
+	HANDLE event;
+	DispJobQueue queue;
+
+	void Process();
+	static DWORD WINAPI ThreadProc(LPVOID param);
+	static DispApartment *Get(kind_t kind);
+
+	static std::vector<DispApartment*> sta_pool;
+	static DispApartment *mta;
+	static ULONG sta_threads;
+	static ULONG sta_next;
+	static LONGLONG queue_ticks;
+	static FlatMap<std::wstring, int, FlatHashNoCase, FlatEqualNoCase> kinds;
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Object pointer valid in its apartment only, released by apartment thread
+// Objects returned by synchronous calls have no owned pointer, their proxies are unmarshaled by apartment thread
+
+class DispHome {
+public:
+	inline DispHome(DispApartment *apt, IDispatch *disp) : apartment(apt), ptr(disp) {}
+	~DispHome();
+	DispApartment *apartment;
+	IDispatch *ptr;
+};
+
+//-------------------------------------------------------------------------------------------------------
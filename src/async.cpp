@@ -0,0 +1,283 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispTask class implementations
+//-------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "async.h"
+
+ULONG DispTask::pending = 0;
+uv_timer_t DispTask::pump;
+bool DispTask::initialized = false;
+DispJobQueue DispTask::completed;
+uv_async_t DispTask::completion;
+
+//-------------------------------------------------------------------------------------------------------
+
+static inline bool IsInterface(const VARIANT &v) {
+	return (v.vt == VT_DISPATCH || v.vt == VT_UNKNOWN) && v.punkVal != nullptr;
+}
+
+static HRESULT MarshalToStream(VARIANT &v, VARTYPE &vt, IStream **stream) {
+	vt = v.vt;
+	HRESULT hrcode = CoMarshalInterThreadInterfaceInStream((vt == VT_DISPATCH) ? IID_IDispatch : IID_IUnknown, v.punkVal, stream);
+	VariantClear(&v);
+	return hrcode;
+}
+
+static HRESULT UnmarshalFromStream(IStream *stream, VARTYPE vt, VARIANT &v) {
+	void *ptr = nullptr;
+	HRESULT hrcode = CoGetInterfaceAndReleaseStream(stream, (vt == VT_DISPATCH) ? IID_IDispatch : IID_IUnknown, &ptr);
+	if SUCCEEDED(hrcode) {
+		VariantClear(&v);
+		v.vt = vt;
+		v.punkVal = (IUnknown*)ptr;
+	}
+	return hrcode;
+}
+
+// Stream was not consumed by other apartment
+static void ReleaseStream(IStream *&stream) {
+	if (!stream) return;
+	LARGE_INTEGER zero = {};
+	stream->Seek(zero, STREAM_SEEK_SET, 0);
+	CoReleaseMarshalData(stream);
+	stream->Release();
+	stream = nullptr;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispTask implemetation
+
+DispTask::call_t::call_t()
+	: dispid(DISPID_UNKNOWN), flags(0), options(0), target(nullptr), result_owned(nullptr), hrcode(S_OK)
+{
+	result_stream.index = 0;
+	result_stream.vt = VT_EMPTY;
+	result_stream.stream = nullptr;
+}
+
+DispTask::call_t::~call_t() {
+	ReleaseStream(target);
+	for (stream_t &item : streams) ReleaseStream(item.stream);
+	ReleaseStream(result_stream.stream);
+	if (result_owned) home->apartment->Release(result_owned);
+}
+
+DispTask::DispTask(bool btch)
+	: batch(btch), apartment(nullptr)
+{
+}
+
+HRESULT DispTask::Start(Isolate *isolate, const Local<Promise::Resolver> &res) {
+
+	// Calls of objects owned by one apartment are queued there, others go to worker pool
+	bool first = true;
+	for (call_t &call : calls) {
+		if (FAILED(call.hrcode)) continue;
+		DispApartment *apt = call.home ? call.home->apartment : nullptr;
+		if (first || apt == apartment) apartment = apt;
+		else { apartment = nullptr; break; }
+		first = false;
+	}
+
+	// Interfaces from the main apartment are unmarshaled by the executing thread
+	for (call_t &call : calls) {
+		if (FAILED(call.hrcode)) continue;
+		if (!call.disp || !call.disp->ptr) return E_POINTER;
+		HRESULT hrcode = (apartment && call.home && call.home->ptr) ? S_OK : CoMarshalInterThreadInterfaceInStream(IID_IDispatch, call.disp->ptr, &call.target);
+		for (size_t i = 0; SUCCEEDED(hrcode) && i < call.args.size(); i++) {
+			if (!IsInterface(call.args[i])) continue;
+			stream_t item = { i, VT_EMPTY, nullptr };
+			hrcode = MarshalToStream(call.args[i], item.vt, &item.stream);
+			if SUCCEEDED(hrcode) call.streams.push_back(item);
+		}
+		if FAILED(hrcode) return hrcode;
+	}
+
+	if (!initialized) {
+		uv_timer_init(uv_default_loop(), &pump);
+		uv_async_init(uv_default_loop(), &completion, OnCompletion);
+		uv_unref((uv_handle_t*)&completion);
+		initialized = true;
+	}
+	if (apartment) apartment->Post(this);
+	else {
+		work.data = this;
+		if (uv_queue_work(uv_default_loop(), &work, OnExecute, OnComplete) != 0) return E_FAIL;
+	}
+	resolver.Reset(isolate, res);
+#ifdef HAS_CALLBACK_SCOPE
+	Local<Object> res_obj = Object::New(isolate);
+	resource.Reset(isolate, res_obj);
+	context = node::EmitAsyncInit(isolate, res_obj, "winax.DispTask");
+#endif
+
+	// Pending timer also keeps the loop alive until apartment tasks are completed
+	if (pending++ == 0) uv_timer_start(&pump, OnPump, 0, 1);
+	return S_OK;
+}
+
+void DispTask::Execute() {
+	if (!apartment) {
+
+		// libuv pool threads live as long as the process, join the multithreaded apartment once
+		static __declspec(thread) bool joined = false;
+		if (!joined) {
+			CoInitializeEx(0, COINIT_MULTITHREADED);
+			joined = true;
+		}
+	}
+	for (call_t &call : calls) {
+		if SUCCEEDED(call.hrcode) Execute(call);
+	}
+}
+
+void DispTask::Execute(call_t &call) {
+	CComPtr<IDispatch> ptr;
+	if (!call.target) ptr = call.home->ptr;
+	else {
+		call.hrcode = CoGetInterfaceAndReleaseStream(call.target, IID_IDispatch, (void**)&ptr);
+		call.target = nullptr;
+	}
+	for (stream_t &item : call.streams) {
+		HRESULT hr = UnmarshalFromStream(item.stream, item.vt, call.args[item.index]);
+		item.stream = nullptr;
+		if (FAILED(hr) && SUCCEEDED(call.hrcode)) call.hrcode = hr;
+	}
+
+	if SUCCEEDED(call.hrcode) {
+		UINT argcnt = (UINT)call.args.size();
+		VARIANT *pargs = (argcnt > 0) ? &call.args.front() : 0;
+		call.hrcode = DispInvoke(ptr, call.dispid, argcnt, pargs, &call.result, call.flags);
+		if FAILED(call.hrcode) {
+			CComPtr<IErrorInfo> errinfo;
+			if (GetErrorInfo(0, &errinfo) == S_OK) errinfo->GetDescription(&call.desc);
+		}
+	}
+
+	// Nothing from the worker apartment may outlive this call, objects of own apartments stay there
+	if (SUCCEEDED(call.hrcode) && IsInterface(call.result)) {
+		if (apartment && call.result.vt == VT_DISPATCH) {
+			call.result_owned = call.result.pdispVal;
+			call.result_owned->AddRef();
+		}
+		HRESULT hr = MarshalToStream(call.result, call.result_stream.vt, &call.result_stream.stream);
+		if FAILED(hr) call.hrcode = hr;
+	}
+	for (CComVariant &arg : call.args) arg.Clear();
+}
+
+Local<Value> DispTask::Complete(Isolate *isolate, call_t &call) {
+	if (call.result_stream.stream) {
+		HRESULT hr = UnmarshalFromStream(call.result_stream.stream, call.result_stream.vt, call.result);
+		call.result_stream.stream = nullptr;
+		if FAILED(hr) call.hrcode = hr;
+	}
+
+	if FAILED(call.hrcode) {
+		Local<Value> error = Exception::Error(GetWin32ErroroMessage(isolate, call.hrcode, L"DispInvokeAsync", call.name.c_str(), call.desc));
+		if (batch) error->ToObject()->Set(String::NewFromUtf8(isolate, "hresult"), Int32::New(isolate, call.hrcode));
+		return error;
+	}
+
+	CComPtr<IDispatch> ptr;
+	if (VariantDispGet(&call.result, &ptr) && ptr) {
+		std::wstring tag;
+		tag.reserve(32);
+		tag += L"@";
+		tag += call.name;
+		Local<Object> parent;
+		DispInfoPtr disp_result(new DispInfo(ptr, tag, call.options, &call.disp));
+		if (call.result_owned) {
+			disp_result->home.reset(new DispHome(apartment, call.result_owned));
+			call.result_owned = nullptr;
+		}
+		return DispObject::NodeCreate(isolate, parent, disp_result, tag);
+	}
+	return Variant2Result(isolate, call.result, call.options);
+}
+
+void DispTask::Complete(Isolate *isolate) {
+	HandleScope scope(isolate);
+	Local<Promise::Resolver> res = resolver.Get(isolate);
+	Context::Scope context_scope(res->CreationContext());
+
+	if (batch) {
+		Local<Array> results = Array::New(isolate, (int)calls.size());
+		for (size_t i = 0; i < calls.size(); i++) {
+			results->Set((uint32_t)i, Complete(isolate, calls[i]));
+		}
+		res->Resolve(results);
+	}
+	else if (!calls.empty()) {
+		Local<Value> result = Complete(isolate, calls[0]);
+		if SUCCEEDED(calls[0].hrcode) res->Resolve(result);
+		else res->Reject(result);
+	}
+}
+
+void DispTask::OnExecute(uv_work_t *req) {
+	DispTask *task = (DispTask*)req->data;
+	task->Execute();
+}
+
+void DispTask::Run() {
+	Execute();
+	completed.Push(this);
+	uv_async_send(&completion);
+}
+
+// Promise is settled inside callback scope of the task, so node drains nextTick queue and microtasks
+// and async hooks see the context where the call was started
+void DispTask::Finish(Isolate *isolate) {
+#ifdef HAS_CALLBACK_SCOPE
+	{
+		HandleScope scope(isolate);
+		node::CallbackScope callback_scope(isolate, resource.Get(isolate), context);
+		Complete(isolate);
+	}
+	node::EmitAsyncDestroy(isolate, context);
+	resource.Reset();
+#else
+	Complete(isolate);
+#endif
+	resolver.Reset();
+	delete this;
+	if (--pending == 0) uv_timer_stop(&pump);
+}
+
+void DispTask::OnComplete(uv_work_t *req, int status) {
+	DispTask *task = (DispTask*)req->data;
+	Isolate *isolate = Isolate::GetCurrent();
+	if (status != 0) {
+		for (call_t &call : task->calls) {
+			if SUCCEEDED(call.hrcode) call.hrcode = E_ABORT;
+		}
+	}
+	task->Finish(isolate);
+#ifndef HAS_CALLBACK_SCOPE
+	isolate->RunMicrotasks();
+#endif
+}
+
+void DispTask::OnCompletion(uv_async_t *handle) {
+	Isolate *isolate = Isolate::GetCurrent();
+	while (DispJob *job = completed.Pop()) {
+		static_cast<DispTask*>(job)->Finish(isolate);
+	}
+#ifndef HAS_CALLBACK_SCOPE
+	isolate->RunMicrotasks();
+#endif
+}
+
+void DispTask::OnPump(uv_timer_t *handle) {
+	MSG msg;
+	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------
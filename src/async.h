@@ -0,0 +1,91 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispTask class declarations. Asynchronous invocation of dispatch members on worker threads
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "disp.h"
+
+// Public callback scope and async context API (node 8.12, 9.6 and later)
+#if NODE_MAJOR_VERSION > 9 || (NODE_MAJOR_VERSION == 9 && NODE_MINOR_VERSION >= 6) || (NODE_MAJOR_VERSION == 8 && NODE_MINOR_VERSION >= 12)
+#define HAS_CALLBACK_SCOPE
+#endif
+
+//-------------------------------------------------------------------------------------------------------
+
+class DispTask: public DispJob {
+public:
+
+	// Interface pointers are moved between apartments by marshaling streams
+	struct stream_t {
+		size_t index;
+		VARTYPE vt;
+		IStream *stream;
+	};
+
+	struct call_t {
+		DispInfoPtr disp;
+		std::shared_ptr<DispHome> home;
+		DISPID dispid;
+		WORD flags;
+		int options;
+		std::wstring name;
+		std::vector<CComVariant> args;	// reverse order as in DISPPARAMS
+
+		IStream *target;
+		std::vector<stream_t> streams;
+		stream_t result_stream;
+		IDispatch *result_owned;
+
+		// Results filled by worker thread
+		HRESULT hrcode;
+		CComVariant result;
+		CComBSTR desc;
+
+		call_t();
+		~call_t();
+	};
+
+	// Batch task is settled with array of results, failed calls become Error items
+	explicit DispTask(bool btch = false);
+	std::vector<call_t> calls;	// sized once before filling, items are not copied
+
+	// Queues calls to objects apartment or worker thread, promise is settled on the main thread
+	HRESULT Start(Isolate *isolate, const Local<Promise::Resolver> &res);
+
+	// Executed by apartment thread
+	virtual void Run();
+
+private:
+	bool batch;
+	DispApartment *apartment;
+	uv_work_t work;
+	Persistent<Promise::Resolver> resolver;
+#ifdef HAS_CALLBACK_SCOPE
+	Persistent<Object> resource;
+	node::async_context context;
+#endif
+
+	void Execute();
+	void Execute(call_t &call);
+	void Complete(Isolate *isolate);
+	Local<Value> Complete(Isolate *isolate, call_t &call);
+	void Finish(Isolate *isolate);
+	static void OnExecute(uv_work_t *req);
+	static void OnComplete(uv_work_t *req, int status);
+
+	// Tasks executed by apartment threads are completed through this queue
+	static DispJobQueue completed;
+	static uv_async_t completion;
+	static void OnCompletion(uv_async_t *handle);
+
+	// Main thread apartment has to process calls from workers while tasks are pending
+	static ULONG pending;
+	static uv_timer_t pump;
+	static bool initialized;
+	static void OnPump(uv_timer_t *handle);
+};
+
+//-------------------------------------------------------------------------------------------------------
@@ -0,0 +1,235 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispBenchmark class implementations
+//-------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "bench.h"
+#include "server.h"
+
+LONGLONG DispBenchmark::arguments_ticks = 0;
+
+// Handles are released by blocks, so scopes do not distort the loop and memory stays flat
+static const ULONG bench_block = 1024;
+
+//-------------------------------------------------------------------------------------------------------
+// DispBenchmark implemetation
+
+DispBenchmark::DispBenchmark(Isolate *iso, ULONG iter) : isolate(iso), count(0), iterations(iter) {
+	results = Array::New(isolate);
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	tick_ns = 1e9 / freq.QuadPart;
+}
+
+void DispBenchmark::Add(const char *suite, const char *name, ULONG iter, LONGLONG ticks) {
+	Local<Object> item = Object::New(isolate);
+	item->Set(String::NewFromUtf8(isolate, "suite"), String::NewFromUtf8(isolate, suite));
+	item->Set(String::NewFromUtf8(isolate, "name"), String::NewFromUtf8(isolate, name));
+	item->Set(String::NewFromUtf8(isolate, "iterations"), Number::New(isolate, (double)iter));
+	item->Set(String::NewFromUtf8(isolate, "ns"), Number::New(isolate, (iter > 0) ? ticks * tick_ns / iter : 0));
+	results->Set(count++, item);
+}
+
+void DispBenchmark::Variant2Values() {
+	struct sample_t { const char *name; CComVariant value; };
+	sample_t samples[14];
+	samples[0].name = "I1"; samples[0].value.vt = VT_I1; samples[0].value.cVal = -5;
+	samples[1].name = "I2"; samples[1].value.vt = VT_I2; samples[1].value.iVal = -1234;
+	samples[2].name = "I4"; samples[2].value.vt = VT_I4; samples[2].value.lVal = 123456;
+	samples[3].name = "UI4"; samples[3].value.vt = VT_UI4; samples[3].value.ulVal = 3000000000u;
+	samples[4].name = "I8"; samples[4].value.vt = VT_I8; samples[4].value.llVal = 9007199254740993LL;
+	samples[5].name = "UI8"; samples[5].value.vt = VT_UI8; samples[5].value.ullVal = 18446744073709551615ULL;
+	samples[6].name = "R4"; samples[6].value.vt = VT_R4; samples[6].value.fltVal = 0.5f;
+	samples[7].name = "R8"; samples[7].value.vt = VT_R8; samples[7].value.dblVal = 1.25;
+	samples[8].name = "CY"; samples[8].value.vt = VT_CY; samples[8].value.cyVal.int64 = 123456789;
+	samples[9].name = "DECIMAL"; VarDecFromR8(12.345, &samples[9].value.decVal); samples[9].value.vt = VT_DECIMAL;
+	samples[10].name = "DATE"; samples[10].value.vt = VT_DATE; samples[10].value.date = 44197.5;
+	samples[11].name = "BOOL"; samples[11].value.vt = VT_BOOL; samples[11].value.boolVal = VARIANT_TRUE;
+	samples[12].name = "BSTR"; samples[12].value.vt = VT_BSTR; samples[12].value.bstrVal = SysAllocString(L"Name");
+	samples[13].name = "I4|BYREF"; samples[13].value.vt = VT_I4 | VT_BYREF; samples[13].value.plVal = &samples[2].value.lVal;
+
+	for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+		const VARIANT &v = samples[s].value;
+		LONGLONG started = Now();
+		for (ULONG done = 0; done < iterations; done += bench_block) {
+			HandleScope scope(isolate);
+			for (ULONG i = 0; i < bench_block; i++) Variant2Value(isolate, v);
+		}
+		Add("Variant2Value", samples[s].name, (iterations + bench_block - 1) / bench_block * bench_block, Now() - started);
+	}
+	samples[13].value.vt = VT_EMPTY;
+}
+
+void DispBenchmark::Values2Variant() {
+	HandleScope scope(isolate);
+	Local<Array> arr = Array::New(isolate, 4);
+	for (uint32_t i = 0; i < 4; i++) arr->Set(i, Number::New(isolate, i + 0.5));
+	struct sample_t { const char *name; Local<Value> value; };
+	std::vector<sample_t> samples;
+	sample_t sample;
+	sample.name = "int32"; sample.value = Int32::New(isolate, -5); samples.push_back(sample);
+	sample.name = "uint32"; sample.value = Uint32::New(isolate, 3000000000u); samples.push_back(sample);
+	sample.name = "number"; sample.value = Number::New(isolate, 2.5); samples.push_back(sample);
+	sample.name = "boolean"; sample.value = Boolean::New(isolate, true); samples.push_back(sample);
+	sample.name = "date"; sample.value = Date::New(isolate, 1.5e12); samples.push_back(sample);
+	sample.name = "string"; sample.value = String::NewFromUtf8(isolate, "Name"); samples.push_back(sample);
+	sample.name = "null"; sample.value = Null(isolate); samples.push_back(sample);
+	sample.name = "array4"; sample.value = arr; samples.push_back(sample);
+#ifdef HAS_BIGINT
+	sample.name = "bigint"; sample.value = BigInt::New(isolate, 9007199254740993LL); samples.push_back(sample);
+#endif
+
+	for (size_t s = 0; s < samples.size(); s++) {
+		LONGLONG started = Now();
+		for (ULONG done = 0; done < iterations; done += bench_block) {
+			HandleScope block_scope(isolate);
+			for (ULONG i = 0; i < bench_block; i++) {
+				VARIANT v;
+				v.vt = VT_EMPTY;
+				Value2Variant(isolate, samples[s].value, v);
+				VariantClear(&v);
+			}
+		}
+		Add("Value2Variant", samples[s].name, (iterations + bench_block - 1) / bench_block * bench_block, Now() - started);
+	}
+}
+
+// Callback constructs arguments many times, so the time of JS call itself is excluded
+void DispBenchmark::NodeArguments(const FunctionCallbackInfo<Value> &args) {
+	Isolate *isolate = args.GetIsolate();
+	ULONG cnt = args.Data()->Uint32Value();
+	LONGLONG started = Now();
+	for (ULONG i = 0; i < cnt; i++) {
+		VarArguments vargs(isolate, args);
+	}
+	arguments_ticks += Now() - started;
+}
+
+void DispBenchmark::Arguments() {
+	static const int counts[] = { 0, 1, 2, 4, 8, 16 };
+	HandleScope scope(isolate);
+	ULONG inner = 100, calls = (iterations + inner - 1) / inner;
+	Local<Function> func = FunctionTemplate::New(isolate, NodeArguments, Uint32::New(isolate, inner))->GetFunction();
+	Local<Value> argv[16];
+	for (int i = 0; i < 16; i++) {
+		if (i % 2 == 0) argv[i] = Int32::New(isolate, i);
+		else argv[i] = String::NewFromUtf8(isolate, "arg");
+	}
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		char name[16];
+		sprintf_s(name, "%i args", counts[c]);
+		arguments_ticks = 0;
+		for (ULONG i = 0; i < calls; i++) func->Call(Undefined(isolate), counts[c], argv);
+		Add("VarArguments", name, calls * inner, arguments_ticks);
+	}
+}
+
+void DispBenchmark::TypeInfo() {
+	static const ULONG sizes[] = { 8, 64, 512 };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		CComPtr<DispTestServer> server(new DispTestServer());
+		for (ULONG m = 0; m < sizes[s]; m++) {
+			DispTestServer::member_t member;
+			wchar_t name[16];
+			swprintf_s(name, L"Member%u", m);
+			server->members.push_back(member);
+			server->members.back().name = name;
+			server->members.back().method = (m % 2) != 0;
+		}
+		if FAILED(server->BuildTypeInfo()) continue;
+
+		// Descriptions built by CreateDispTypeInfo have no GUID, so they are never taken from the cache
+		ULONG iter = iterations / sizes[s] + 1;
+		LONGLONG started = Now();
+		for (ULONG i = 0; i < iter; i++) {
+			DispInfo info(server, L"Bench", option_type | option_eager);
+		}
+		char name[32];
+		sprintf_s(name, "Prepare %u members", sizes[s]);
+		Add("DispInfo", name, iter, Now() - started);
+	}
+}
+
+void DispBenchmark::NodeEcho(const FunctionCallbackInfo<Value> &args) {
+	if (args.Length() > 0) args.GetReturnValue().Set(args[0]);
+}
+
+void DispBenchmark::DispImpl() {
+	HandleScope scope(isolate);
+	Local<Object> obj = Object::New(isolate);
+	obj->Set(String::NewFromUtf8(isolate, "value"), Int32::New(isolate, 1));
+	obj->Set(String::NewFromUtf8(isolate, "echo"), FunctionTemplate::New(isolate, NodeEcho)->GetFunction());
+	CComPtr<IDispatch> disp(new DispObjectImpl(obj));
+
+	LPOLESTR names[] = { (LPOLESTR)L"echo", (LPOLESTR)L"value" };
+	DISPID ids[2];
+	LONGLONG started = Now();
+	for (ULONG i = 0; i < iterations; i++) disp->GetIDsOfNames(IID_NULL, &names[i % 2], 1, LOCALE_USER_DEFAULT, &ids[i % 2]);
+	Add("DispObjectImpl", "GetIDsOfNames", iterations, Now() - started);
+
+	CComVariant arg(5L);
+	DISPPARAMS params = { &arg, 0, 1, 0 };
+	started = Now();
+	for (ULONG i = 0; i < iterations; i++) {
+		CComVariant ret;
+		disp->Invoke(ids[0], IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD, &params, &ret, NULL, NULL);
+	}
+	Add("DispObjectImpl", "Invoke method", iterations, Now() - started);
+
+	DISPPARAMS noparams = { 0, 0, 0, 0 };
+	started = Now();
+	for (ULONG i = 0; i < iterations; i++) {
+		CComVariant ret;
+		disp->Invoke(ids[1], IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_PROPERTYGET, &noparams, &ret, NULL, NULL);
+	}
+	Add("DispObjectImpl", "Invoke property get", iterations, Now() - started);
+}
+
+void DispBenchmark::Errors() {
+	struct sample_t { const char *name; HRESULT hrcode; LPCOLESTR desc; };
+	static const sample_t samples[] = {
+		{ "system message", DISP_E_MEMBERNOTFOUND, nullptr },
+		{ "unknown code", 0x80041234, nullptr },
+		{ "description", E_FAIL, L"Error description from EXCEPINFO" }
+	};
+	ULONG iter = iterations / 10 + 1;
+	for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+		LONGLONG started = Now();
+		for (ULONG done = 0; done < iter; done += bench_block) {
+			HandleScope scope(isolate);
+			ULONG block = (iter - done < bench_block) ? iter - done : bench_block;
+			for (ULONG i = 0; i < block; i++) GetWin32ErroroMessage(isolate, samples[s].hrcode, L"DispInvoke", L"Member", samples[s].desc);
+		}
+		Add("GetWin32ErroroMessage", samples[s].name, iter, Now() - started);
+	}
+}
+
+void DispBenchmark::NodeRun(const FunctionCallbackInfo<Value> &args) {
+	Isolate *isolate = args.GetIsolate();
+	ULONG iterations = 100000;
+	Local<Array> suites;
+	if (args.Length() > 0 && args[0]->IsObject()) {
+		Local<Object> opt = args[0]->ToObject();
+		Local<Value> val = opt->Get(String::NewFromUtf8(isolate, "iterations"));
+		if (!val.IsEmpty() && val->IsUint32() && val->Uint32Value() > 0) iterations = val->Uint32Value();
+		val = opt->Get(String::NewFromUtf8(isolate, "suites"));
+		if (!val.IsEmpty() && val->IsArray()) suites = Local<Array>::Cast(val);
+	}
+
+	static const char *names[] = { "Variant2Value", "Value2Variant", "VarArguments", "DispInfo", "DispObjectImpl", "GetWin32ErroroMessage" };
+	static void (DispBenchmark::*runs[])() = { &DispBenchmark::Variant2Values, &DispBenchmark::Values2Variant, &DispBenchmark::Arguments, &DispBenchmark::TypeInfo, &DispBenchmark::DispImpl, &DispBenchmark::Errors };
+	DispBenchmark bench(isolate, iterations);
+	for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+		bool selected = suites.IsEmpty();
+		for (uint32_t i = 0; !selected && i < suites->Length(); i++) {
+			String::Utf8Value name(suites->Get(i));
+			selected = *name && strcmp(*name, names[r]) == 0;
+		}
+		if (selected) (bench.*runs[r])();
+	}
+	args.GetReturnValue().Set(bench.results);
+}
+
+//-------------------------------------------------------------------------------------------------------
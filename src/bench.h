@@ -0,0 +1,46 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispBenchmark class declarations. Native timing of marshaling and dispatch hot paths
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "disp.h"
+
+//-------------------------------------------------------------------------------------------------------
+// Loops run inside the addon, so results do not include JS call overhead
+
+class DispBenchmark {
+public:
+	// winax.benchmark({ iterations, suites }) returns [{ suite, name, iterations, ns }]
+	static void NodeRun(const FunctionCallbackInfo<Value> &args);
+
+private:
+	Isolate *isolate;
+	Local<Array> results;
+	uint32_t count;
+	ULONG iterations;
+	double tick_ns;
+
+	DispBenchmark(Isolate *iso, ULONG iter);
+	static inline LONGLONG Now() {
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return now.QuadPart;
+	}
+	void Add(const char *suite, const char *name, ULONG iter, LONGLONG ticks);
+
+	void Variant2Values();
+	void Values2Variant();
+	void Arguments();
+	void TypeInfo();
+	void DispImpl();
+	void Errors();
+
+	static LONGLONG arguments_ticks;
+	static void NodeArguments(const FunctionCallbackInfo<Value> &args);
+	static void NodeEcho(const FunctionCallbackInfo<Value> &args);
+};
+
+//-------------------------------------------------------------------------------------------------------
@@ -6,9 +6,204 @@
 
 #include "stdafx.h"
 #include "disp.h"
+#include "async.h"
+#include "enum.h"
+#include "profiler.h"
+#include "server.h"
+#include "bench.h"
 
 Persistent<ObjectTemplate> DispObject::inst_template;
 Persistent<FunctionTemplate> DispObject::clazz_template;
+Persistent<FunctionTemplate> DispObject::valueof_template;
+Persistent<FunctionTemplate> DispObject::tostring_template;
+DispObject::templates_t DispObject::typed_templates;
+bool DispObject::accessors = true;
+Persistent<String> DispObject::special_names[DispObject::special_count];
+DispNames::types_t DispNames::by_type;
+
+//-------------------------------------------------------------------------------------------------------
+// DispNames implemetation
+
+DispNamesPtr DispNames::Get(ITypeInfo *info) {
+	TYPEATTR *attr;
+	if (!info || info->GetTypeAttr(&attr) != S_OK) return DispNamesPtr();
+	GUID guid = attr->guid;
+	info->ReleaseTypeAttr(attr);
+	return Get(guid);
+}
+
+DispNamesPtr DispNames::Get(const GUID &guid) {
+	if (guid == GUID_NULL) return DispNamesPtr();
+	types_t::iterator it = by_type.find(guid);
+	if (it != by_type.end()) return it->second;
+
+	// Bounded by type cache capacity, names of types not used by live objects are dropped first,
+	// when all are used the object keeps names itself
+	size_t capacity = DispTypeCache::GetCapacity();
+	for (it = by_type.begin(); by_type.size() >= capacity && it != by_type.end();) {
+		if (it->second.use_count() == 1) it = by_type.erase(it);
+		else ++it;
+	}
+	if (by_type.size() >= capacity) return DispNamesPtr();
+	DispNamesPtr &ptr = by_type[guid];
+	ptr.reset(new DispNames());
+	return ptr;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispTypeCache implemetation
+
+ULONGLONG DispStats::funcdesc = 0;
+ULONGLONG DispStats::type_hits = 0;
+ULONGLONG DispStats::type_misses = 0;
+ULONGLONG DispStats::type_evictions = 0;
+
+DispTypeCache::items_t DispTypeCache::items;
+DispTypeCache::order_t DispTypeCache::order;
+size_t DispTypeCache::capacity = 256;
+
+DispTypeDescPtr DispTypeCache::Find(const GUID &guid, LCID lcid) {
+	key_t key = { guid, lcid };
+	items_t::iterator it = items.find(key);
+	if (it == items.end()) return DispTypeDescPtr();
+	order.splice(order.begin(), order, it->second.pos);
+	DispStats::type_hits++;
+	return it->second.desc;
+}
+
+DispTypeDescPtr DispTypeCache::Get(ITypeInfo *info, LCID lcid) {
+	TYPEATTR *attr;
+	if (!info || info->GetTypeAttr(&attr) != S_OK) return DispTypeDescPtr();
+	key_t key = { attr->guid, lcid };
+	UINT cnt = attr->cFuncs;
+	info->ReleaseTypeAttr(attr);
+	if (key.guid != GUID_NULL) {
+		DispTypeDescPtr desc = Find(key.guid, lcid);
+		if (desc) return desc;
+	}
+
+	// Build complete description, it is not changed after
+	DispStats::type_misses++;
+	std::shared_ptr<DispTypeDesc> desc(new DispTypeDesc());
+	desc->types_by_dispid.reserve(cnt);
+	DispTypeDesc::PrepareType(info, [&desc](ITypeInfo *tinfo, FUNCDESC *fdesc) {
+		desc->types_by_dispid[fdesc->memid].add(fdesc);
+	});
+	if (key.guid == GUID_NULL || capacity == 0) return desc;
+	order.push_front(key);
+	item_t &item = items[key];
+	item.desc = desc;
+	item.pos = order.begin();
+	Shrink();
+	return desc;
+}
+
+void DispTypeCache::SetCapacity(size_t cnt) {
+	capacity = cnt;
+	Shrink();
+}
+
+void DispTypeCache::Shrink() {
+	while (items.size() > capacity && !order.empty()) {
+		items.erase(order.back());
+		order.pop_back();
+		DispStats::type_evictions++;
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispInfo implemetation
+
+void DispInfo::Prepare(IDispatch *disp) {
+	type_loaded = true;
+	UINT cnt;
+	if (!ptr || FAILED(ptr->GetTypeInfoCount(&cnt)) || cnt == 0) return;
+	CComPtr<ITypeInfo> info;
+	if (ptr->GetTypeInfo(0, 0, &info) != S_OK || !info) return;
+	TYPEATTR *attr;
+	if (info->GetTypeAttr(&attr) != S_OK) return;
+	type_guid = attr->guid;
+	info->ReleaseTypeAttr(attr);
+	type_desc = DispTypeCache::Get(info, 0);
+	type_names = DispNames::Get(type_guid);
+	bool prepared = type_desc && type_desc->types_by_dispid.size() > 3; // QueryInterface, AddRef, Release
+	if (prepared) options |= option_prepared;
+}
+
+bool DispInfo::LoadTypeInfo() {
+	if (type_loaded) return (options & option_prepared) != 0;
+	type_loaded = true;
+	if ((options & option_type) == 0 || !ptr) return false;
+
+	// Only type attributes are loaded here, members are resolved by ResolveType
+	UINT cnt;
+	if (FAILED(ptr->GetTypeInfoCount(&cnt)) || cnt == 0) return false;
+	if (ptr->GetTypeInfo(0, 0, &type_info) != S_OK || !type_info) return false;
+	TYPEATTR *attr;
+	if (type_info->GetTypeAttr(&attr) != S_OK) {
+		type_info.Release();
+		return false;
+	}
+	bool prepared = attr->cFuncs > 3; // QueryInterface, AddRef, Release
+	type_guid = attr->guid;
+	type_names = DispNames::Get(attr->guid);
+	type_desc = DispTypeCache::Find(attr->guid, 0);
+	type_info->ReleaseTypeAttr(attr);
+	if (!type_desc) type_info->QueryInterface(__uuidof(ITypeInfo2), (void**)&type_info2);
+	if (prepared) options |= option_prepared;
+	return prepared;
+}
+
+const DispInfo::type_t *DispInfo::ResolveType(DISPID dispid) {
+
+	// Without ITypeInfo2 members can not be found by DISPID, so load all of them
+	if (!type_info2) {
+		type_desc = DispTypeCache::Get(type_info, 0);
+		return type_desc ? type_desc->Find(dispid) : nullptr;
+	}
+
+	// Resolve member once, unknown members are memoized too
+	bool inserted;
+	type_t &type = types_by_dispid.insert(dispid, inserted);
+	if (inserted) {
+		static const INVOKEKIND kinds[] = { INVOKE_FUNC, INVOKE_PROPERTYGET, INVOKE_PROPERTYPUT, INVOKE_PROPERTYPUTREF };
+		for (INVOKEKIND kind : kinds) {
+			UINT index;
+			if (type_info2->GetFuncIndexOfMemId(dispid, kind, &index) != S_OK) continue;
+			DispTypeDesc::PrepareFunc(type_info, index, [&type](ITypeInfo *info, FUNCDESC *desc) {
+				type.add(desc);
+			});
+		}
+	}
+	return (type.kind != 0) ? &type : nullptr;
+}
+
+HRESULT DispInfo::FindProperty(LPOLESTR name, DISPID *dispid) {
+	bool typed = LoadTypeInfo();
+	if (type_names && type_names->Find(name, dispid)) return S_OK;
+	if (names.Find(name, dispid)) return S_OK;
+
+	// Lazy mode resolves name by type information, it does not need a call to the object
+	if (typed && type_info && (options & option_eager) == 0) {
+		if (type_info->GetIDsOfNames(&name, 1, dispid) == S_OK) {
+			if (type_names) type_names->Add(name, *dispid);
+			else names.Add(name, *dispid);
+			return S_OK;
+		}
+	}
+
+	HRESULT hrcode = DispFind(ptr, name, dispid);
+	if SUCCEEDED(hrcode) {
+
+		// Only members described by type info may be shared, dynamic names (macros, WMI properties) are per object
+		const type_t *type = type_desc ? type_desc->Find(*dispid) : nullptr;
+		if (type_names && type) type_names->Add(name, *dispid);
+		else names.Add(name, *dispid);
+	}
+
+	// Unknown names are not cached, members may appear later (VBA macros, IDispatchEx expando properties)
+	return hrcode;
+}
 
 //-------------------------------------------------------------------------------------------------------
 // DispObject implemetation
@@ -25,12 +220,18 @@ DispObject::DispObject(const DispInfoPtr &ptr, const std::wstring &nm, DISPID id
 }
 
 DispObject::~DispObject() {
+	clearChildren();
 	NODE_DEBUG_FMT("DispObject '%S' destructor", name.c_str());
 }
 
 HRESULT DispObject::prepare() {
 	CComVariant value;
-	HRESULT hrcode = disp ? disp->GetProperty(dispid, index, &value) : E_UNEXPECTED;
+	HRESULT hrcode = E_UNEXPECTED;
+	if (disp) {
+		LONGLONG started = DispProfiler::enabled ? DispProfiler::Now() : 0;
+		hrcode = disp->GetProperty(dispid, index, &value);
+		if (started) DispProfiler::Record(DispProfiler::kind_get, disp->name, dispid, name.c_str(), hrcode, started);
+	}
 
 	// Init dispatch interface
 	options |= option_prepared;
@@ -47,10 +248,55 @@ bool DispObject::release() {
     if (!disp) return false;
     NODE_DEBUG_FMT("DispObject '%S' release", name.c_str());
     disp.reset();            
+    clearChildren();
     return true;
 }
 
-bool DispObject::get(LPOLESTR tag, LONG index, const PropertyCallbackInfo<Value> &args) {
+bool DispObject::findChild(Isolate *isolate, const child_key_t &key, Local<Object> &result) {
+	children_t::iterator it = children.find(key);
+	if (it == children.end()) return false;
+
+	// Released child may keep identity of destroyed object, so it is replaced,
+	// method wrapper used as an object is prepared (holds result of the member), so it is replaced too
+	Local<Object> obj = it->second->obj.Get(isolate);
+	DispObject *child = obj.IsEmpty() ? nullptr : Unwrap<DispObject>(obj);
+	if (!child || !child->disp || (!key.second && child->is_prepared())) {
+		it->second->obj.Reset();
+		delete it->second;
+		children.erase(it);
+		return false;
+	}
+	result = obj;
+	return true;
+}
+
+void DispObject::addChild(Isolate *isolate, const child_key_t &key, const Local<Object> &obj) {
+	child_t *&child = children[key];
+	if (!child) {
+		child = new child_t;
+		child->owner = this;
+		child->key = key;
+	}
+	child->obj.Reset(isolate, obj);
+	child->obj.SetWeak(child, NodeChildWeak, WeakCallbackType::kParameter);
+}
+
+void DispObject::clearChildren() {
+	for (children_t::iterator it = children.begin(); it != children.end(); ++it) {
+		it->second->obj.Reset();
+		delete it->second;
+	}
+	children.clear();
+}
+
+void DispObject::NodeChildWeak(const WeakCallbackInfo<child_t> &data) {
+	child_t *child = data.GetParameter();
+	child->obj.Reset();
+	child->owner->children.erase(child->key);
+	delete child;
+}
+
+bool DispObject::get(LPOLESTR tag, DISPID propid, LONG index, const PropertyCallbackInfo<Value> &args) {
 	Isolate *isolate = args.GetIsolate();
 	if (!is_prepared()) prepare();
     if (!disp) {
@@ -60,13 +306,12 @@ bool DispObject::get(LPOLESTR tag, LONG index, const PropertyCallbackInfo<Value>
 
 	// Search dispid
     HRESULT hrcode;
-    DISPID propid;
 	bool prop_by_key = false;
     if (!tag) {
         tag = (LPOLESTR)name.c_str();
         propid = dispid;
     }
-	else {
+	else if (propid == DISPID_UNKNOWN) {
         hrcode = disp->FindProperty(tag, &propid);
         if (SUCCEEDED(hrcode) && propid == DISPID_UNKNOWN) hrcode = E_INVALIDARG;
         if FAILED(hrcode) {
@@ -88,8 +333,8 @@ bool DispObject::get(LPOLESTR tag, LONG index, const PropertyCallbackInfo<Value>
 		opt |= option_property;
 	}
 	else {
-		DispInfo::type_ptr disp_info;
-		if (disp->GetTypeInfo(propid, disp_info)) {
+		const DispInfo::type_t *disp_info = disp->GetTypeInfo(propid);
+		if (disp_info) {
 			if (disp_info->is_property()) opt |= option_property;
 			is_property_simple = disp_info->is_property_simple();
 		}
@@ -99,36 +344,66 @@ bool DispObject::get(LPOLESTR tag, LONG index, const PropertyCallbackInfo<Value>
 	if (is_property_simple) {
 		CComVariant value;
 		VarArguments vargs;
-		if (prop_by_key) vargs.items.push_back(CComVariant(tag));
-		if (index >= 0) vargs.items.push_back(CComVariant(index));
+		if (prop_by_key) {
+			VARIANT &key = vargs.items.append();
+			key.vt = VT_BSTR;
+			key.bstrVal = SysAllocString(tag);
+		}
+		if (index >= 0) {
+			VARIANT &item = vargs.items.append();
+			item.vt = VT_I4;
+			item.lVal = index;
+		}
 		LONG argcnt = (LONG)vargs.items.size();
 		VARIANT *pargs = (argcnt > 0) ? &vargs.items.front() : 0;
 		//hrcode = disp->GetProperty(propid, index, &value);
+		LONGLONG started = DispProfiler::enabled ? DispProfiler::Now() : 0;
 		hrcode = disp->GetProperty(propid, argcnt, pargs, &value);
+		if (started) DispProfiler::Record(DispProfiler::kind_get, disp->name, propid, tag, hrcode, started);
 		if (FAILED(hrcode) && dispid != DISPID_VALUE){
 			isolate->ThrowException(DispError(isolate, hrcode, L"DispPropertyGet", tag));
 			return false;
 		}
 		CComPtr<IDispatch> ptr;
 		if (VariantDispGet(&value, &ptr)) {
-			DispInfoPtr disp_result(new DispInfo(ptr, tag, options, &disp));
-			Local<Object> result = DispObject::NodeCreate(isolate, args.This(), disp_result, tag, DISPID_UNKNOWN, -1, opt);
+
+			// Return the same object while property returns the same instance
+			Local<Object> result;
+			CComPtr<IUnknown> unk;
+			bool cache = (options & option_cache) != 0 && ptr && SUCCEEDED(ptr->QueryInterface(IID_IUnknown, (void**)&unk));
+			child_key_t key(propid, unk);
+			if (!cache || !findChild(isolate, key, result)) {
+				DispInfoPtr disp_result(new DispInfo(ptr, tag, options, &disp));
+				result = DispObject::NodeCreate(isolate, args.This(), disp_result, tag, DISPID_UNKNOWN, -1, opt);
+				if (cache && !result.IsEmpty()) addChild(isolate, key, result);
+			}
 			args.GetReturnValue().Set(result);
 		}
 		else {
-			args.GetReturnValue().Set(Variant2Value(isolate, value));
+			args.GetReturnValue().Set(Variant2Result(isolate, value, options));
 		}
 	}
 
-	// Return as dispatch object 
+	// Return as dispatch object, wrapper of member is reused, so calls in loops do not allocate it
 	else {
-		Local<Object> result = DispObject::NodeCreate(isolate, args.This(), disp, tag, propid, index, opt);
+		Local<Object> result;
+		child_key_t key(propid, nullptr);
+		bool reuse = (index < 0);
+		if (!reuse || !findChild(isolate, key, result)) {
+			result = DispObject::NodeCreate(isolate, args.This(), disp, tag, propid, index, opt);
+			if (reuse && !result.IsEmpty()) addChild(isolate, key, result);
+		}
 		args.GetReturnValue().Set(result);
 	}
 	return true;
 }
 
-bool DispObject::set(LPOLESTR tag, LONG index, const Local<Value> &value, const PropertyCallbackInfo<Value> &args) {
+// Accessor setters have no result
+static inline void SetResult(const PropertyCallbackInfo<Value> &args, const Local<Value> &result) { args.GetReturnValue().Set(result); }
+static inline void SetResult(const PropertyCallbackInfo<void> &args, const Local<Value> &result) {}
+
+template<typename T>
+bool DispObject::set(LPOLESTR tag, DISPID propid, LONG index, const Local<Value> &value, const PropertyCallbackInfo<T> &args) {
 	Isolate *isolate = args.GetIsolate();
 	if (!is_prepared()) prepare();
     if (!disp) {
@@ -138,12 +413,11 @@ bool DispObject::set(LPOLESTR tag, LONG index, const Local<Value> &value, const
 	
 	// Search dispid
 	HRESULT hrcode;
-	DISPID propid;
 	if (!tag) {
 		tag = (LPOLESTR)name.c_str();
 		propid = dispid;
 	}
-	else {
+	else if (propid == DISPID_UNKNOWN) {
 		hrcode = disp->FindProperty(tag, &propid);
 		if (SUCCEEDED(hrcode) && propid == DISPID_UNKNOWN) hrcode = E_INVALIDARG;
 		if FAILED(hrcode) {
@@ -154,11 +428,17 @@ bool DispObject::set(LPOLESTR tag, LONG index, const Local<Value> &value, const
 
 	// Set value using dispatch
     CComVariant ret;
-	VarArguments vargs(isolate, value);
-	if (index >= 0) vargs.items.push_back(CComVariant(index));
+	VarArguments vargs(isolate, value, options);
+	if (index >= 0) {
+		VARIANT &item = vargs.items.append();
+		item.vt = VT_I4;
+		item.lVal = index;
+	}
 	LONG argcnt = (LONG)vargs.items.size();
     VARIANT *pargs = (argcnt > 0) ? &vargs.items.front() : 0;
+	LONGLONG started = DispProfiler::enabled ? DispProfiler::Now() : 0;
 	hrcode = disp->SetProperty(propid, argcnt, pargs, &ret);
+	if (started) DispProfiler::Record(DispProfiler::kind_set, disp->name, propid, tag, hrcode, started);
 	if FAILED(hrcode) {
 		isolate->ThrowException(DispError(isolate, hrcode, L"DispPropertyPut", tag));
         return false;
@@ -173,10 +453,10 @@ bool DispObject::set(LPOLESTR tag, LONG index, const Local<Value> &value, const
 		rtag += tag;
 		DispInfoPtr disp_result(new DispInfo(ptr, tag, options, &disp));
 		Local<Object> result = DispObject::NodeCreate(isolate, args.This(), disp_result, rtag);
-		args.GetReturnValue().Set(result);
+		SetResult(args, result);
 	}
 	else {
-		args.GetReturnValue().Set(Variant2Value(isolate, ret));
+		SetResult(args, Variant2Result(isolate, ret, options));
 	}
     return true;
 }
@@ -188,13 +468,15 @@ void DispObject::call(Isolate *isolate, const FunctionCallbackInfo<Value> &args)
     }
     
 	CComVariant ret;
-	VarArguments vargs(isolate, args);
+	VarArguments vargs(isolate, args, options);
 	LONG argcnt = (LONG)vargs.items.size();
 	VARIANT *pargs = (argcnt > 0) ? &vargs.items.front() : 0;
 	HRESULT hrcode;
 
+	LONGLONG started = DispProfiler::enabled ? DispProfiler::Now() : 0;
 	if ((options & option_property) == 0) hrcode = disp->ExecuteMethod(dispid, argcnt, pargs, &ret);
 	else hrcode = disp->GetProperty(dispid, argcnt, pargs, &ret);
+	if (started) DispProfiler::Record(DispProfiler::kind_call, disp->name, dispid, name.c_str(), hrcode, started);
     if FAILED(hrcode) {
         isolate->ThrowException(DispError(isolate, hrcode, L"DispInvoke", name.c_str()));
         return;
@@ -212,17 +494,31 @@ void DispObject::call(Isolate *isolate, const FunctionCallbackInfo<Value> &args)
 		result = DispObject::NodeCreate(isolate, args.This(), disp_result, tag);
 	}
 	else {
-		result = Variant2Value(isolate, ret);
+		result = Variant2Result(isolate, ret, options);
 	}
     args.GetReturnValue().Set(result);
 }
 
+bool DispObject::GetDispatch(Isolate *isolate, const Local<Value> &obj, IDispatch **result) {
+	Local<FunctionTemplate> clazz = clazz_template.Get(isolate);
+	if (clazz.IsEmpty() || !clazz->HasInstance(obj)) return false;
+	DispObject *self = Unwrap<DispObject>(obj->ToObject());
+	if (!self) return false;
+	if (!self->is_prepared()) self->prepare();
+	if (!self->disp || !self->is_object() || !self->disp->ptr) return false;
+	*result = self->disp->ptr;
+	(*result)->AddRef();
+	return true;
+}
+
 HRESULT DispObject::valueOf(Isolate *isolate, VARIANT &value) {
 	if (!is_prepared()) prepare();
 	HRESULT hrcode;
 	if (!disp) hrcode = E_UNEXPECTED;
 	else {
+		LONGLONG started = DispProfiler::enabled ? DispProfiler::Now() : 0;
 		hrcode = disp->GetProperty(dispid, index, &value);
+		if (started) DispProfiler::Record(DispProfiler::kind_get, disp->name, dispid, name.c_str(), hrcode, started);
 		if (FAILED(hrcode) && is_object()) {
 			value.vt = VT_DISPATCH;
 			value.pdispVal = disp ? (IDispatch*)disp->ptr : NULL;
@@ -239,8 +535,10 @@ HRESULT DispObject::valueOf(Isolate *isolate, const Local<Object> &self, Local<V
 	if (!disp) hrcode = E_UNEXPECTED;
 	else {
 		CComVariant val;
+		LONGLONG started = DispProfiler::enabled ? DispProfiler::Now() : 0;
 		hrcode = disp->GetProperty(dispid, index, &val);
-		if SUCCEEDED(hrcode) value = Variant2Value(isolate, val);
+		if (started) DispProfiler::Record(DispProfiler::kind_get, disp->name, dispid, name.c_str(), hrcode, started);
+		if SUCCEEDED(hrcode) value = Variant2Result(isolate, val, options);
 		else if (is_object()) {
 			value = self;
 			hrcode = S_OK;
@@ -260,6 +558,19 @@ void DispObject::toString(const FunctionCallbackInfo<Value> &args) {
 	args.GetReturnValue().Set(Variant2String(isolate, val));
 }
 
+// Collection items are enumerated by object returned from _NewEnum
+HRESULT DispObject::getEnumerator(IEnumVARIANT **result) {
+	if (!is_prepared()) prepare();
+	if (!disp) return E_UNEXPECTED;
+	if (!is_object()) return DISP_E_MEMBERNOTFOUND;
+	CComVariant value;
+	DISPPARAMS params = { 0, 0, 0, 0 };
+	HRESULT hrcode = disp->ptr->Invoke(DISPID_NEWENUM, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD | DISPATCH_PROPERTYGET, &params, &value, NULL, NULL);
+	if FAILED(hrcode) return hrcode;
+	if ((value.vt != VT_UNKNOWN && value.vt != VT_DISPATCH) || !value.punkVal) return E_NOINTERFACE;
+	return value.punkVal->QueryInterface(IID_IEnumVARIANT, (void**)result);
+}
+
 Local<Value> DispObject::getIdentity(Isolate *isolate) {
     std::wstring id;
     id.reserve(128);
@@ -281,14 +592,18 @@ Local<Value> DispObject::getTypeInfo(Isolate *isolate) {
     }
     uint32_t index = 0;
     Local<v8::Array> items(v8::Array::New(isolate));
-    disp->Enumerate([isolate, this, &items, &index](ITypeInfo *info, FUNCDESC *desc) {
+	Local<String> key_name = String::NewFromUtf8(isolate, "name", String::kInternalizedString);
+	Local<String> key_dispid = String::NewFromUtf8(isolate, "dispid", String::kInternalizedString);
+	Local<String> key_invkind = String::NewFromUtf8(isolate, "invkind", String::kInternalizedString);
+	Local<String> key_argcnt = String::NewFromUtf8(isolate, "argcnt", String::kInternalizedString);
+    disp->Enumerate([&](ITypeInfo *info, FUNCDESC *desc) {
         CComBSTR name;
         this->disp->GetItemName(info, desc->memid, &name); 
         Local<Object> item(Object::New(isolate));
-        if (name) item->Set(String::NewFromUtf8(isolate, "name"), String::NewFromTwoByte(isolate, (uint16_t*)(BSTR)name));
-        item->Set(String::NewFromUtf8(isolate, "dispid"), Int32::New(isolate, desc->memid));
-        item->Set(String::NewFromUtf8(isolate, "invkind"), Int32::New(isolate, desc->invkind));
-        item->Set(String::NewFromUtf8(isolate, "argcnt"), Int32::New(isolate, desc->cParams));
+        if (name) item->Set(key_name, Bstr2String(isolate, name, true));
+        item->Set(key_dispid, Int32::New(isolate, desc->memid));
+        item->Set(key_invkind, Int32::New(isolate, desc->invkind));
+        item->Set(key_argcnt, Int32::New(isolate, desc->cParams));
         items->Set(index++, item);
     });
     return items;
@@ -297,6 +612,14 @@ Local<Value> DispObject::getTypeInfo(Isolate *isolate) {
 //-----------------------------------------------------------------------------------
 // Static Node JS callbacks
 
+static int ApartmentKind(LPOLESTR name) {
+	if (!name) return -1;
+	if (_wcsicmp(name, L"sta") == 0) return DispApartment::apartment_sta;
+	if (_wcsicmp(name, L"mta") == 0) return DispApartment::apartment_mta;
+	if (_wcsicmp(name, L"main") == 0) return DispApartment::apartment_main;
+	return -1;
+}
+
 void DispObject::NodeInit(const Local<Object> &target) {
     Isolate *isolate = target->GetIsolate();
 
@@ -304,31 +627,105 @@ void DispObject::NodeInit(const Local<Object> &target) {
     Local<FunctionTemplate> clazz = FunctionTemplate::New(isolate, NodeCreate);
     clazz->SetClassName(String::NewFromUtf8(isolate, "Dispatch"));
 
-	NODE_SET_PROTOTYPE_METHOD(clazz, "toString", NodeToString);
-	NODE_SET_PROTOTYPE_METHOD(clazz, "valueOf", NodeValueOf);
+	// Prototype methods are also returned by interceptor, function of template is created once per context
+	Local<Signature> signature = Signature::New(isolate, clazz);
+	Local<FunctionTemplate> tostring = FunctionTemplate::New(isolate, NodeToString, Local<Value>(), signature);
+	Local<FunctionTemplate> valueof = FunctionTemplate::New(isolate, NodeValueOf, Local<Value>(), signature);
+	Local<String> tostring_name = String::NewFromUtf8(isolate, "toString", String::kInternalizedString);
+	Local<String> valueof_name = String::NewFromUtf8(isolate, "valueOf", String::kInternalizedString);
+	tostring->SetClassName(tostring_name);
+	valueof->SetClassName(valueof_name);
+	clazz->PrototypeTemplate()->Set(tostring_name, tostring);
+	clazz->PrototypeTemplate()->Set(valueof_name, valueof);
+	tostring_template.Reset(isolate, tostring);
+	valueof_template.Reset(isolate, valueof);
 
     Local<ObjectTemplate> &inst = clazz->InstanceTemplate();
-    inst->SetInternalFieldCount(1);
-    inst->SetNamedPropertyHandler(NodeGet, NodeSet);
-    inst->SetIndexedPropertyHandler(NodeGetByIndex, NodeSetByIndex);
-    inst->SetCallAsFunctionHandler(NodeCall);
+	ConfigureTemplate(isolate, inst, false);
 	inst->SetNativeDataProperty(String::NewFromUtf8(isolate, "__id"), NodeGet);
 	inst->SetNativeDataProperty(String::NewFromUtf8(isolate, "__value"), NodeGet);
     inst->SetNativeDataProperty(String::NewFromUtf8(isolate, "__type"), NodeGet);
 
+	// Collections support for-of and for-await-of loops
+	Local<Symbol> sym;
+	if (GetWellKnownSymbol(isolate, "iterator", sym)) clazz->PrototypeTemplate()->Set(sym, FunctionTemplate::New(isolate, NodeIterator));
+	if (GetWellKnownSymbol(isolate, "asyncIterator", sym)) clazz->PrototypeTemplate()->Set(sym, FunctionTemplate::New(isolate, NodeAsyncIterator));
+	DispEnumerator::NodeInit(isolate);
+
+	const char *specials[special_count] = { "__value", "__id", "__type", "__proto__", "valueOf", "toString" };
+	for (int i = 0; i < special_count; i++) {
+		special_names[i].Reset(isolate, String::NewFromUtf8(isolate, specials[i], String::kInternalizedString));
+	}
+
     inst_template.Reset(isolate, inst);
 	clazz_template.Reset(isolate, clazz);
     target->Set(String::NewFromUtf8(isolate, "Object"), clazz->GetFunction());
     target->Set(String::NewFromUtf8(isolate, "release"), FunctionTemplate::New(isolate, NodeRelease, target)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "stats"), FunctionTemplate::New(isolate, NodeStats)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "configure"), FunctionTemplate::New(isolate, NodeConfigure)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "fetchRows"), FunctionTemplate::New(isolate, NodeFetchRows)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "callAsync"), FunctionTemplate::New(isolate, NodeCallAsync)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "getAsync"), FunctionTemplate::New(isolate, NodeGetAsync)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "setAsync"), FunctionTemplate::New(isolate, NodeSetAsync)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "batch"), FunctionTemplate::New(isolate, NodeBatch)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "testServer"), FunctionTemplate::New(isolate, DispTestServer::NodeCreate)->GetFunction());
+    target->Set(String::NewFromUtf8(isolate, "benchmark"), FunctionTemplate::New(isolate, DispBenchmark::NodeRun)->GetFunction());
     
     //Context::GetCurrent()->Global()->Set(String::NewFromUtf8("ActiveXObject"), t->GetFunction());
 	NODE_DEBUG_MSG("DispObject initialized");
 }
 
+// Accessors of typed templates are own properties, non masking interceptor is not called for them
+void DispObject::ConfigureTemplate(Isolate *isolate, Local<ObjectTemplate> &inst, bool typed) {
+    inst->SetInternalFieldCount(1);
+	if (!typed) inst->SetNamedPropertyHandler(NodeGet, NodeSet);
+	else inst->SetHandler(NamedPropertyHandlerConfiguration(NodeGetNamed, NodeSetNamed, 0, 0, 0, Local<Value>(), PropertyHandlerFlags::kNonMasking));
+    inst->SetIndexedPropertyHandler(NodeGetByIndex, NodeSetByIndex);
+    inst->SetCallAsFunctionHandler(NodeCall);
+}
+
+// Template is built once per interface GUID, its class inherits Dispatch (prototype methods, __id, __value, __type).
+// Type information is not loaded here, only objects with complete description (eager mode) get accessors
+Local<ObjectTemplate> DispObject::GetTemplate(Isolate *isolate, const DispInfoPtr &ptr) {
+	Local<ObjectTemplate> inst = inst_template.Get(isolate);
+
+	// Interface GUID is known only after type attributes are loaded, lazy objects do not call the server
+	// on creation for it, so they keep the interceptor template even when the description is cached
+	if (!accessors || !ptr || !ptr->type_loaded || ptr->type_guid == GUID_NULL) return inst;
+	if ((ptr->options & option_prepared) == 0) return inst;
+	templates_t::iterator it = typed_templates.find(ptr->type_guid);
+	if (it != typed_templates.end()) return it->second->Get(isolate);
+	if (typed_templates.size() >= DispTypeCache::GetCapacity()) return inst;
+
+	// Members are taken from shared description, type information is needed for names only
+	DispTypeDescPtr desc = ptr->type_desc ? ptr->type_desc : DispTypeCache::Find(ptr->type_guid, 0);
+	if (!desc) return inst;
+	CComPtr<ITypeInfo> info(ptr->type_info);
+	if (!info && (ptr->ptr->GetTypeInfo(0, 0, &info) != S_OK || !info)) return inst;
+	Local<FunctionTemplate> clazz = FunctionTemplate::New(isolate);
+	clazz->SetClassName(String::NewFromUtf8(isolate, "Dispatch"));
+	clazz->Inherit(clazz_template.Get(isolate));
+	Local<ObjectTemplate> typed = clazz->InstanceTemplate();
+	ConfigureTemplate(isolate, typed, true);
+	desc->types_by_dispid.for_each([&](DISPID dispid, const DispTypeDesc::type_t &type) {
+		CComBSTR name;
+		UINT cnt;
+		if (!type.is_property_simple() || info->GetNames(dispid, &name, 1, &cnt) != S_OK || cnt == 0 || !name) return;
+		Local<String> key = Bstr2String(isolate, name, true);
+		if (GetSpecial(key) >= 0) return;
+
+		// Not enumerable, so inspection of the object does not call the server
+		typed->SetAccessor(key, NodeGetTyped, NodeSetTyped, Int32::New(isolate, dispid), DEFAULT, DontEnum);
+	});
+	Persistent<ObjectTemplate> *item = new Persistent<ObjectTemplate>(isolate, typed);
+	typed_templates[ptr->type_guid] = item;
+	return typed;
+}
+
 Local<Object> DispObject::NodeCreate(Isolate *isolate, const Local<Object> &parent, const DispInfoPtr &ptr, const std::wstring &name, DISPID id, LONG index, int opt) {
     Local<Object> self;
     if (!inst_template.IsEmpty()) {
-        self = inst_template.Get(isolate)->NewInstance();
+        self = ((id == DISPID_UNKNOWN) ? GetTemplate(isolate, ptr) : inst_template.Get(isolate))->NewInstance();
         (new DispObject(ptr, name, id, index, opt))->Wrap(self);
 		//Local<String> prop_id(String::NewFromUtf8(isolate, "_identity"));
 		//self->Set(prop_id, String::NewFromTwoByte(isolate, (uint16_t*)name));
@@ -344,6 +741,7 @@ void DispObject::NodeCreate(const FunctionCallbackInfo<Value> &args) {
         return;
     }
     int options = (option_async | option_type);
+	int apartment = -1;
     if (argcnt > 1) {
         Local<Value> argopt = args[1];
         if (!argopt.IsEmpty() && argopt->IsObject()) {
@@ -357,6 +755,26 @@ void DispObject::NodeCreate(const FunctionCallbackInfo<Value> &args) {
 			if (v8val2bool(opt->Get(String::NewFromUtf8(isolate, "activate")), false)) {
 				options |= option_activate;
 			}
+			if (v8val2bool(opt->Get(String::NewFromUtf8(isolate, "eager")), false)) {
+				options |= option_eager;
+			}
+			if (v8val2bool(opt->Get(String::NewFromUtf8(isolate, "cache")), false)) {
+				options |= option_cache;
+			}
+			if (v8val2bool(opt->Get(String::NewFromUtf8(isolate, "typedArrays")), false)) {
+				options |= option_typed;
+			}
+			Local<Value> arrays = opt->Get(String::NewFromUtf8(isolate, "arrays"));
+			if (!arrays.IsEmpty() && arrays->IsString()) {
+				String::Value varrays(arrays);
+				if (_wcsicmp((LPOLESTR)*varrays, L"variant") == 0) options |= option_array_variant;
+				else if (_wcsicmp((LPOLESTR)*varrays, L"reference") == 0) options |= option_array_ref;
+			}
+			Local<Value> argapt = opt->Get(String::NewFromUtf8(isolate, "apartment"));
+			if (!argapt.IsEmpty() && argapt->IsString()) {
+				String::Value vapt(argapt);
+				apartment = ApartmentKind((LPOLESTR)*vapt);
+			}
 		}
     }
     
@@ -380,6 +798,7 @@ void DispObject::NodeCreate(const FunctionCallbackInfo<Value> &args) {
 	HRESULT hrcode;
 	std::wstring name;
 	CComPtr<IDispatch> disp;
+	std::shared_ptr<DispHome> home;
 	if (args[0]->IsString()) {
 
 		// Prepare arguments
@@ -390,7 +809,16 @@ void DispObject::NodeCreate(const FunctionCallbackInfo<Value> &args) {
 			name.assign((LPOLESTR)*vname, vname.length());
 			CLSID clsid;
 			hrcode = CLSIDFromProgID(name.c_str(), &clsid);
-			if SUCCEEDED(hrcode) {
+			if (SUCCEEDED(hrcode) && apartment < 0) apartment = DispApartment::GetKind(name);
+
+			// Object owned by dedicated apartment thread
+			if (SUCCEEDED(hrcode) && apartment != DispApartment::apartment_main) {
+				IDispatch *owned;
+				DispApartment *apt;
+				hrcode = DispApartment::CreateInstance((DispApartment::kind_t)apartment, clsid, (options & option_activate) != 0, &disp, &owned, &apt);
+				if SUCCEEDED(hrcode) home.reset(new DispHome(apt, owned));
+			}
+			else if SUCCEEDED(hrcode) {
 				if ((options & option_activate) == 0) hrcode = E_FAIL; 
 				else {
 					CComPtr<IUnknown> unk;
@@ -421,8 +849,13 @@ void DispObject::NodeCreate(const FunctionCallbackInfo<Value> &args) {
 		isolate->ThrowException(DispError(isolate, hrcode, L"CreateInstance", name.c_str()));
 	}
 	else {
-		Local<Object> &self = args.This();
+		Local<Object> self = args.This();
 		DispInfoPtr ptr(new DispInfo(disp, name, options));
+		ptr->home = home;
+
+		// Constructor returns instance of typed template instead of the created receiver
+		Local<ObjectTemplate> inst = GetTemplate(isolate, ptr);
+		if (inst != inst_template.Get(isolate)) self = inst->NewInstance();
 		(new DispObject(ptr, name))->Wrap(self);
 		args.GetReturnValue().Set(self);
 	}
@@ -436,35 +869,87 @@ void DispObject::NodeGet(Local<String> name, const PropertyCallbackInfo<Value>&
 		return;
 	}
 	
-	String::Value vname(name);
-	LPOLESTR id = (vname.length() > 0) ? (LPOLESTR)*vname : L"";
-    NODE_DEBUG_FMT2("DispObject '%S.%S' get", self->name.c_str(), id);
-    if (_wcsicmp(id, L"__value") == 0) {
+	switch (GetSpecial(name)) {
+	case special_value: {
         Local<Value> result;
         HRESULT hrcode = self->valueOf(isolate, args.This(), result);
         if FAILED(hrcode) isolate->ThrowException(Win32Error(isolate, hrcode, L"DispValueOf"));
         else args.GetReturnValue().Set(result);
-    }
-    else if (_wcsicmp(id, L"__id") == 0) {
+		break; }
+	case special_id:
 		args.GetReturnValue().Set(self->getIdentity(isolate));
-	}
-    else if (_wcsicmp(id, L"__type") == 0) {
+		break;
+	case special_type:
         args.GetReturnValue().Set(self->getTypeInfo(isolate));
-    }
-	else if (_wcsicmp(id, L"__proto__") == 0) {
+		break;
+	case special_proto: {
 		Local<FunctionTemplate> clazz = clazz_template.Get(isolate);
 		if (clazz.IsEmpty()) args.GetReturnValue().SetNull();
 		else args.GetReturnValue().Set(clazz_template.Get(isolate)->GetFunction());
+		break; }
+	case special_valueof:
+		args.GetReturnValue().Set(valueof_template.Get(isolate)->GetFunction());
+		break;
+	case special_tostring:
+		args.GetReturnValue().Set(tostring_template.Get(isolate)->GetFunction());
+		break;
+	default: {
+		NameBuffer id(name);
+		NODE_DEBUG_FMT2("DispObject '%S.%S' get", self->name.c_str(), (LPOLESTR)id);
+		self->get(id, DISPID_UNKNOWN, -1, args);
+		}
 	}
-	else if (_wcsicmp(id, L"valueOf") == 0) {
-		args.GetReturnValue().Set(FunctionTemplate::New(isolate, NodeValueOf, args.This())->GetFunction());
+}
+
+// Non masking interceptor of typed templates is called for symbols too
+void DispObject::NodeGetNamed(Local<Name> name, const PropertyCallbackInfo<Value>& args) {
+	if (name->IsString()) NodeGet(Local<String>::Cast(name), args);
+}
+
+void DispObject::NodeSetNamed(Local<Name> name, Local<Value> value, const PropertyCallbackInfo<Value>& args) {
+	if (name->IsString()) NodeSet(Local<String>::Cast(name), value, args);
+}
+
+void DispObject::NodeGetTyped(Local<String> name, const PropertyCallbackInfo<Value>& args) {
+    Isolate *isolate = args.GetIsolate();
+	DispObject *self = DispObject::Unwrap<DispObject>(args.This());
+	if (!self) {
+		isolate->ThrowException(DispErrorInvalid(isolate));
+		return;
 	}
-	else if (_wcsicmp(id, L"toString") == 0) {
-		args.GetReturnValue().Set(FunctionTemplate::New(isolate, NodeToString, args.This())->GetFunction());
+	NameBuffer id(name);
+	self->get(id, args.Data()->Int32Value(), -1, args);
+}
+
+void DispObject::NodeSetTyped(Local<String> name, Local<Value> value, const PropertyCallbackInfo<void>& args) {
+    Isolate *isolate = args.GetIsolate();
+	DispObject *self = DispObject::Unwrap<DispObject>(args.This());
+	if (!self) {
+		isolate->ThrowException(DispErrorInvalid(isolate));
+		return;
 	}
-	else {
-		self->get(id, -1, args);
+	NameBuffer id(name);
+	self->set(id, args.Data()->Int32Value(), -1, value, args);
+}
+
+// Interceptors receive internalized names, so special names are found without string comparison,
+// other letter case (obj.tostring, obj.__ID) is still matched by case insensitive comparison
+int DispObject::GetSpecial(const Local<String> &name) {
+	static const wchar_t *specials[special_count] = { L"__value", L"__id", L"__type", L"__proto__", L"valueOf", L"toString" };
+	for (int i = 0; i < special_count; i++) {
+		if (name == special_names[i]) return i;
+	}
+	int len = name->Length();
+	if (len < 4 || len > 9) return -1;
+	OLECHAR buf[10];
+	name->Write((uint16_t*)buf, 0, 1, String::NO_NULL_TERMINATION);
+	if (buf[0] != L'_' && buf[0] != L'v' && buf[0] != L'V' && buf[0] != L't' && buf[0] != L'T') return -1;
+	name->Write((uint16_t*)buf, 0, len, String::NO_NULL_TERMINATION);
+	buf[len] = 0;
+	for (int i = 0; i < special_count; i++) {
+		if (_wcsicmp(buf, specials[i]) == 0) return i;
 	}
+	return -1;
 }
 
 void DispObject::NodeGetByIndex(uint32_t index, const PropertyCallbackInfo<Value>& args) {
@@ -475,7 +960,7 @@ void DispObject::NodeGetByIndex(uint32_t index, const PropertyCallbackInfo<Value
 		return;
 	}
     NODE_DEBUG_FMT2("DispObject '%S[%u]' get", self->name.c_str(), index);
-    self->get(0, index, args);
+    self->get(0, DISPID_UNKNOWN, index, args);
 }
 
 void DispObject::NodeSet(Local<String> name, Local<Value> value, const PropertyCallbackInfo<Value>& args) {
@@ -485,10 +970,9 @@ void DispObject::NodeSet(Local<String> name, Local<Value> value, const PropertyC
 		isolate->ThrowException(DispErrorInvalid(isolate));
 		return;
 	}
-	String::Value vname(name);
-	LPOLESTR id = (vname.length() > 0) ? (LPOLESTR)*vname : L"";
-	NODE_DEBUG_FMT2("DispObject '%S.%S' set", self->name.c_str(), id);
-    self->set(id, -1, value, args);
+	NameBuffer id(name);
+	NODE_DEBUG_FMT2("DispObject '%S.%S' set", self->name.c_str(), (LPOLESTR)id);
+    self->set(id, DISPID_UNKNOWN, -1, value, args);
 }
 
 void DispObject::NodeSetByIndex(uint32_t index, Local<Value> value, const PropertyCallbackInfo<Value>& args) {
@@ -499,7 +983,7 @@ void DispObject::NodeSetByIndex(uint32_t index, Local<Value> value, const Proper
 		return;
 	}
 	NODE_DEBUG_FMT2("DispObject '%S[%u]' set", self->name.c_str(), index);
-	self->set(0, index, value, args);
+	self->set(0, DISPID_UNKNOWN, index, value, args);
 }
 
 void DispObject::NodeCall(const FunctionCallbackInfo<Value> &args) {
@@ -539,6 +1023,30 @@ void DispObject::NodeToString(const FunctionCallbackInfo<Value>& args) {
 	self->toString(args);
 }
 
+void DispObject::NodeIterator(const FunctionCallbackInfo<Value>& args) {
+	NodeEnumerate(args, false);
+}
+
+void DispObject::NodeAsyncIterator(const FunctionCallbackInfo<Value>& args) {
+	NodeEnumerate(args, true);
+}
+
+void DispObject::NodeEnumerate(const FunctionCallbackInfo<Value>& args, bool async) {
+	Isolate *isolate = args.GetIsolate();
+	DispObject *self = DispObject::Unwrap<DispObject>(args.This());
+	if (!self) {
+		isolate->ThrowException(DispErrorInvalid(isolate));
+		return;
+	}
+	CComPtr<IEnumVARIANT> enm;
+	HRESULT hrcode = self->getEnumerator(&enm);
+	if FAILED(hrcode) {
+		isolate->ThrowException(DispError(isolate, hrcode, L"DispEnumerate", self->name.c_str()));
+		return;
+	}
+	args.GetReturnValue().Set(DispEnumerator::NodeCreate(isolate, enm, self->options, async));
+}
+
 void DispObject::NodeRelease(const FunctionCallbackInfo<Value>& args) {
 	Isolate *isolate = args.GetIsolate();
     int rcnt = 0, argcnt = args.Length();
@@ -554,4 +1062,409 @@ void DispObject::NodeRelease(const FunctionCallbackInfo<Value>& args) {
     args.GetReturnValue().Set(rcnt);
 }
 
+void DispObject::NodeStats(const FunctionCallbackInfo<Value>& args) {
+	Isolate *isolate = args.GetIsolate();
+	Local<Object> result(Object::New(isolate));
+	result->Set(String::NewFromUtf8(isolate, "funcdesc"), Number::New(isolate, (double)DispStats::funcdesc));
+	Local<Object> types(Object::New(isolate));
+	types->Set(String::NewFromUtf8(isolate, "hits"), Number::New(isolate, (double)DispStats::type_hits));
+	types->Set(String::NewFromUtf8(isolate, "misses"), Number::New(isolate, (double)DispStats::type_misses));
+	types->Set(String::NewFromUtf8(isolate, "evictions"), Number::New(isolate, (double)DispStats::type_evictions));
+	types->Set(String::NewFromUtf8(isolate, "size"), Number::New(isolate, (double)DispTypeCache::GetSize()));
+	types->Set(String::NewFromUtf8(isolate, "capacity"), Number::New(isolate, (double)DispTypeCache::GetCapacity()));
+	result->Set(String::NewFromUtf8(isolate, "typeCache"), types);
+	result->Set(String::NewFromUtf8(isolate, "templates"), Number::New(isolate, (double)typed_templates.size()));
+	Local<Object> server(Object::New(isolate));
+	server->Set(String::NewFromUtf8(isolate, "lookups"), Number::New(isolate, (double)DispTestServer::lookups));
+	result->Set(String::NewFromUtf8(isolate, "testServer"), server);
+	Local<Object> apartments(Object::New(isolate));
+	apartments->Set(String::NewFromUtf8(isolate, "threads"), Number::New(isolate, (double)DispApartment::GetRunning()));
+	apartments->Set(String::NewFromUtf8(isolate, "jobs"), Number::New(isolate, (double)DispApartment::jobs));
+	apartments->Set(String::NewFromUtf8(isolate, "queueTime"), Number::New(isolate, (double)DispApartment::GetQueueTime()));
+	result->Set(String::NewFromUtf8(isolate, "apartments"), apartments);
+	if (DispProfiler::enabled) result->Set(String::NewFromUtf8(isolate, "members"), DispProfiler::Dump(isolate));
+	if (args.Length() > 0 && v8val2bool(args[0], false)) {
+		DispProfiler::Reset();
+		DispStats::funcdesc = 0;
+		DispStats::type_hits = 0;
+		DispStats::type_misses = 0;
+		DispStats::type_evictions = 0;
+		DispApartment::ResetStats();
+		DispTestServer::lookups = 0;
+	}
+	args.GetReturnValue().Set(result);
+}
+
+void DispObject::NodeConfigure(const FunctionCallbackInfo<Value>& args) {
+	Isolate *isolate = args.GetIsolate();
+	if (args.Length() > 0 && args[0]->IsObject()) {
+		Local<Object> opt = args[0]->ToObject();
+		Local<Value> val = opt->Get(String::NewFromUtf8(isolate, "typeCacheSize"));
+		if (!val.IsEmpty() && val->IsUint32()) DispTypeCache::SetCapacity(val->Uint32Value());
+		val = opt->Get(String::NewFromUtf8(isolate, "apartmentThreads"));
+		if (!val.IsEmpty() && val->IsUint32()) DispApartment::SetThreads(val->Uint32Value());
+#ifdef HAS_BIGINT
+		val = opt->Get(String::NewFromUtf8(isolate, "bigint"));
+		if (!val.IsEmpty() && val->IsBoolean()) var_bigint = val->BooleanValue();
+#endif
+		val = opt->Get(String::NewFromUtf8(isolate, "profile"));
+		if (!val.IsEmpty() && val->IsBoolean()) DispProfiler::enabled = val->BooleanValue();
+		val = opt->Get(String::NewFromUtf8(isolate, "accessors"));
+		if (!val.IsEmpty() && val->IsBoolean()) accessors = val->BooleanValue();
+		val = opt->Get(String::NewFromUtf8(isolate, "dates"));
+		if (!val.IsEmpty() && val->IsString()) {
+			String::Value vdates(val);
+			if (_wcsicmp((LPOLESTR)*vdates, L"utc") == 0) var_date_utc = true;
+			else if (_wcsicmp((LPOLESTR)*vdates, L"local") == 0) var_date_utc = false;
+		}
+		val = opt->Get(String::NewFromUtf8(isolate, "decimals"));
+		if (!val.IsEmpty() && val->IsString()) {
+			String::Value vdecimals(val);
+			if (_wcsicmp((LPOLESTR)*vdecimals, L"string") == 0) var_decimal_string = true;
+			else if (_wcsicmp((LPOLESTR)*vdecimals, L"number") == 0) var_decimal_string = false;
+		}
+
+		// ProgId to apartment kind
+		val = opt->Get(String::NewFromUtf8(isolate, "apartments"));
+		if (!val.IsEmpty() && val->IsObject()) {
+			Local<Object> kinds = val->ToObject();
+			Local<Array> progids = kinds->GetOwnPropertyNames();
+			for (uint32_t i = 0; i < progids->Length(); i++) {
+				Local<Value> progid = progids->Get(i);
+				String::Value vprogid(progid);
+				String::Value vkind(kinds->Get(progid));
+				int kind = ApartmentKind((LPOLESTR)*vkind);
+				if (vprogid.length() > 0 && kind >= 0) DispApartment::SetKind((LPOLESTR)*vprogid, (DispApartment::kind_t)kind);
+			}
+		}
+	}
+	Local<Object> result(Object::New(isolate));
+	result->Set(String::NewFromUtf8(isolate, "typeCacheSize"), Number::New(isolate, (double)DispTypeCache::GetCapacity()));
+	result->Set(String::NewFromUtf8(isolate, "apartmentThreads"), Number::New(isolate, (double)DispApartment::GetThreads()));
+	result->Set(String::NewFromUtf8(isolate, "bigint"), Boolean::New(isolate, var_bigint));
+	result->Set(String::NewFromUtf8(isolate, "decimals"), String::NewFromUtf8(isolate, var_decimal_string ? "string" : "number"));
+	result->Set(String::NewFromUtf8(isolate, "dates"), String::NewFromUtf8(isolate, var_date_utc ? "utc" : "local"));
+	result->Set(String::NewFromUtf8(isolate, "profile"), Boolean::New(isolate, DispProfiler::enabled));
+	result->Set(String::NewFromUtf8(isolate, "accessors"), Boolean::New(isolate, accessors));
+	args.GetReturnValue().Set(result);
+}
+
+void DispObject::NodeFetchRows(const FunctionCallbackInfo<Value>& args) {
+	Isolate *isolate = args.GetIsolate();
+	CComPtr<IDispatch> rs;
+	if (args.Length() < 1 || !GetDispatch(isolate, args[0], &rs)) {
+		isolate->ThrowException(InvalidArgumentsError(isolate));
+		return;
+	}
+
+	// Prepare GetRows(Rows, Start, Fields) arguments in reverse order
+	CComVariant vargs[3];
+	bool columnar = false;
+	vargs[2].vt = VT_I4;
+	vargs[2].lVal = -1; // adGetRowsRest
+	vargs[1].vt = VT_ERROR;
+	vargs[1].scode = DISP_E_PARAMNOTFOUND;
+	vargs[0].vt = VT_ERROR;
+	vargs[0].scode = DISP_E_PARAMNOTFOUND;
+	if (args.Length() > 1) {
+		Local<Value> argopt = args[1];
+		if (argopt->IsInt32()) vargs[2].lVal = argopt->Int32Value();
+		else if (argopt->IsObject()) {
+			Local<Object> opt = argopt->ToObject();
+			Local<Value> val = opt->Get(String::NewFromUtf8(isolate, "maxRows"));
+			if (!val.IsEmpty() && val->IsInt32()) vargs[2].lVal = val->Int32Value();
+			columnar = v8val2bool(opt->Get(String::NewFromUtf8(isolate, "columnar")), false);
+			val = opt->Get(String::NewFromUtf8(isolate, "columns"));
+			if (!val.IsEmpty() && val->IsArray()) {
+				Local<Array> columns = Local<Array>::Cast(val);
+				CComArray arr;
+				uint32_t cnt = columns->Length();
+				if SUCCEEDED(arr.Prepare(VT_VARIANT, cnt)) {
+					for (uint32_t i = 0; i < cnt; i++) {
+						Local<Value> item = columns->Get(i);
+						Value2Variant(isolate, item, *arr.GetElement<VARIANT>(i));
+					}
+					arr.Detach(&vargs[0]);
+				}
+			}
+			else if (!val.IsEmpty() && !val->IsUndefined() && !val->IsNull()) {
+				vargs[0].vt = VT_EMPTY;
+				Value2Variant(isolate, val, vargs[0]);
+			}
+		}
+	}
+
+	// Fetch rows block in one call, recordset at EOF returns empty block
+	CComVariant ret;
+	HRESULT hrcode = DispInvoke(rs, (LPOLESTR)L"GetRows", 3, vargs, &ret, DISPATCH_METHOD);
+	if FAILED(hrcode) {
+		CComVariant eof;
+		if (SUCCEEDED(DispInvoke(rs, (LPOLESTR)L"EOF", 0, 0, &eof, DISPATCH_PROPERTYGET)) && Variant2Int<int>(eof, 0) != 0) {
+			args.GetReturnValue().Set(Array::New(isolate, 0));
+		}
+		else {
+			isolate->ThrowException(DispError(isolate, hrcode, L"DispFetchRows"));
+		}
+		return;
+	}
+	SAFEARRAY *varr = ((ret.vt & VT_BYREF) != 0) ? *ret.pparray : ret.parray;
+	VARIANT *data;
+	if ((ret.vt & VT_ARRAY) == 0 || (ret.vt & VT_TYPEMASK) != VT_VARIANT || !varr || varr->cDims != 2 || FAILED(SafeArrayAccessData(varr, (void**)&data))) {
+		args.GetReturnValue().Set(Variant2Value(isolate, ret));
+		return;
+	}
+
+	// Array(field, row) is stored by columns: fields of one row are adjacent
+	ULONG cols = varr->rgsabound[1].cElements, rows = varr->rgsabound[0].cElements;
+	Local<Array> result;
+	if (!columnar) {
+		result = Array::New(isolate, rows);
+		for (ULONG r = 0; r < rows; r++) {
+			Local<Array> row = Array::New(isolate, cols);
+			VARIANT *v = data + r * cols;
+			for (ULONG c = 0; c < cols; c++) row->Set(c, Variant2Value(isolate, v[c]));
+			result->Set(r, row);
+		}
+	}
+	else {
+		result = Array::New(isolate, cols);
+		for (ULONG c = 0; c < cols; c++) {
+			double num;
+			bool numeric = rows > 0;
+			for (ULONG r = 0; numeric && r < rows; r++) numeric = Variant2Number(data[c + r * cols], num);
+			if (numeric) {
+				Local<ArrayBuffer> buf = ArrayBuffer::New(isolate, rows * sizeof(double));
+				double *dst = (double*)buf->GetContents().Data();
+				for (ULONG r = 0; r < rows; r++) Variant2Number(data[c + r * cols], dst[r]);
+				result->Set(c, Float64Array::New(buf, 0, rows));
+				continue;
+			}
+
+			// Date columns: times are computed in one pass, local offsets are cached between adjacent values
+			bool dates = rows > 0;
+			for (ULONG r = 0; dates && r < rows; r++) dates = (data[c + r * cols].vt == VT_DATE);
+			if (dates) {
+				std::vector<double> times(rows);
+				for (ULONG r = 0; r < rows; r++) times[r] = OleDate2Time(data[c + r * cols].date);
+				Local<Array> column = Array::New(isolate, rows);
+				for (ULONG r = 0; r < rows; r++) column->Set(r, Date::New(isolate, times[r]));
+				result->Set(c, column);
+			}
+			else {
+				Local<Array> column = Array::New(isolate, rows);
+				for (ULONG r = 0; r < rows; r++) column->Set(r, Variant2Value(isolate, data[c + r * cols]));
+				result->Set(c, column);
+			}
+		}
+	}
+	SafeArrayUnaccessData(varr);
+	args.GetReturnValue().Set(result);
+}
+
+void DispObject::NodeCallAsync(const FunctionCallbackInfo<Value>& args) {
+	NodeInvokeAsync(args, DISPATCH_METHOD | DISPATCH_PROPERTYGET);
+}
+
+void DispObject::NodeGetAsync(const FunctionCallbackInfo<Value>& args) {
+	NodeInvokeAsync(args, DISPATCH_PROPERTYGET);
+}
+
+void DispObject::NodeSetAsync(const FunctionCallbackInfo<Value>& args) {
+	NodeInvokeAsync(args, DISPATCH_PROPERTYPUT);
+}
+
+void DispObject::NodeInvokeAsync(const FunctionCallbackInfo<Value>& args, WORD flags) {
+	Isolate *isolate = args.GetIsolate();
+	Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+	args.GetReturnValue().Set(resolver->GetPromise());
+
+	// Arguments: object, member name, member arguments
+	int argcnt = args.Length() - 2;
+	DispObject *self = (argcnt >= 0 && HasInstance(isolate, args[0])) ? Unwrap<DispObject>(args[0]->ToObject()) : nullptr;
+	if (!self || !args[1]->IsString() || (flags == DISPATCH_PROPERTYPUT && argcnt < 1)) {
+		resolver->Reject(InvalidArgumentsError(isolate));
+		return;
+	}
+	if ((self->options & option_async) == 0) {
+		resolver->Reject(TypeError(isolate, "DispAsyncDisabled"));
+		return;
+	}
+	if (!self->is_prepared()) self->prepare();
+	if (!self->disp || !self->disp->ptr) {
+		resolver->Reject(DispErrorNull(isolate));
+		return;
+	}
+
+	// Member is resolved on the main thread using the name caches
+	String::Value vname(args[1]);
+	LPOLESTR tag = (vname.length() > 0) ? (LPOLESTR)*vname : (LPOLESTR)L"";
+	DISPID propid;
+	HRESULT hrcode = self->disp->FindProperty(tag, &propid);
+	if (SUCCEEDED(hrcode) && propid == DISPID_UNKNOWN) hrcode = E_INVALIDARG;
+	if FAILED(hrcode) {
+		resolver->Reject(DispError(isolate, hrcode, L"DispPropertyFind", tag));
+		return;
+	}
+
+	std::unique_ptr<DispTask> task(new DispTask());
+	task->calls.resize(1);
+	DispTask::call_t &call = task->calls[0];
+	call.disp = self->disp;
+	call.home = self->disp->home;
+	call.dispid = propid;
+	call.flags = flags;
+	call.options = self->options;
+	call.name = tag;
+	call.args.resize(argcnt);
+	for (int i = 0; i < argcnt; i++) {
+		Local<Value> arg = args[2 + argcnt - i - 1];
+		Value2Variant(isolate, arg, call.args[i], self->options);
+	}
+	hrcode = task->Start(isolate, resolver);
+	if FAILED(hrcode) {
+		resolver->Reject(Win32Error(isolate, hrcode, L"DispInvokeAsync", tag));
+		return;
+	}
+	task.release();
+}
+
+void DispObject::NodeBatch(const FunctionCallbackInfo<Value>& args) {
+	Isolate *isolate = args.GetIsolate();
+	if (args.Length() < 1 || !args[0]->IsArray()) {
+		isolate->ThrowException(InvalidArgumentsError(isolate));
+		return;
+	}
+	Local<Array> items = Local<Array>::Cast(args[0]);
+	uint32_t cnt = items->Length();
+	bool async = false;
+	if (args.Length() > 1 && args[1]->IsObject()) {
+		async = v8val2bool(args[1]->ToObject()->Get(String::NewFromUtf8(isolate, "async")), false);
+	}
+	Local<Array> results;
+	std::unique_ptr<DispTask> task;
+	if (async) {
+		task.reset(new DispTask(true));
+		task->calls.resize(cnt);
+	}
+	else results = Array::New(isolate, cnt);
+
+	// Member of the previous item is reused while the same object and name are called
+	DispInfo *last_disp = nullptr;
+	std::wstring last_name;
+	DISPID propid = DISPID_UNKNOWN;
+	std::vector<CComVariant> arena;
+	std::wstring name;
+
+	// Items: [object, 'Method', args...] or [object, 'Property=', value]
+	for (uint32_t i = 0; i < cnt; i++) {
+		Local<Value> item = items->Get(i);
+		Local<Array> entry;
+		DispObject *self = nullptr;
+		if (item->IsArray()) {
+			entry = Local<Array>::Cast(item);
+			Local<Value> obj = entry->Get(0);
+			if (entry->Length() >= 2 && HasInstance(isolate, obj)) self = Unwrap<DispObject>(obj->ToObject());
+		}
+		HRESULT hrcode = self ? S_OK : E_INVALIDARG;
+
+		// Member wrappers are not call targets: known methods are rejected without invoking them,
+		// other wrappers are resolved to their value as GetDispatch does
+		if (SUCCEEDED(hrcode) && !self->is_prepared()) {
+			const DispInfo::type_t *type = self->disp ? self->disp->GetTypeInfo(self->dispid) : nullptr;
+			if (type && !type->is_property()) hrcode = DISP_E_MEMBERNOTFOUND;
+			else self->prepare();
+		}
+		if (SUCCEEDED(hrcode) && (!self->disp || !self->disp->ptr)) hrcode = E_POINTER;
+		if (SUCCEEDED(hrcode) && !self->is_object()) hrcode = DISP_E_MEMBERNOTFOUND;
+
+		// Search dispid
+		WORD flags = DISPATCH_METHOD | DISPATCH_PROPERTYGET;
+		int argcnt = 0;
+		name.clear();
+		if SUCCEEDED(hrcode) {
+			String::Value vname(entry->Get(1));
+			if (vname.length() > 0) name.assign((LPOLESTR)*vname, vname.length());
+			argcnt = (int)entry->Length() - 2;
+			if (!name.empty() && name.back() == L'=') {
+				name.pop_back();
+				flags = DISPATCH_PROPERTYPUT;
+				if (argcnt < 1) hrcode = E_INVALIDARG;
+			}
+		}
+		if (SUCCEEDED(hrcode) && (self->disp.get() != last_disp || _wcsicmp(name.c_str(), last_name.c_str()) != 0)) {
+			hrcode = self->disp->FindProperty((LPOLESTR)name.c_str(), &propid);
+			if (SUCCEEDED(hrcode) && propid == DISPID_UNKNOWN) hrcode = E_INVALIDARG;
+			if SUCCEEDED(hrcode) {
+				last_disp = self->disp.get();
+				last_name = name;
+			}
+			else last_disp = nullptr;
+		}
+
+		// Prepare arguments in reverse order
+		int options = self ? self->options : option_auto;
+		std::vector<CComVariant> &vargs = task ? task->calls[i].args : arena;
+		for (CComVariant &arg : vargs) arg.Clear();
+		vargs.resize(SUCCEEDED(hrcode) ? argcnt : 0);
+		for (int j = 0; j < (int)vargs.size(); j++) {
+			Local<Value> arg = entry->Get(2 + argcnt - j - 1);
+			Value2Variant(isolate, arg, vargs[j], options);
+		}
+
+		// Queue call to worker thread
+		if (task) {
+			DispTask::call_t &call = task->calls[i];
+			call.name = name;
+			call.hrcode = hrcode;
+			if SUCCEEDED(hrcode) {
+				call.disp = self->disp;
+				call.home = self->disp->home;
+				call.dispid = propid;
+				call.flags = flags;
+				call.options = options;
+			}
+			continue;
+		}
+
+		// Execute call, errors are stored as results
+		CComVariant ret;
+		if SUCCEEDED(hrcode) {
+			VARIANT *pargs = (argcnt > 0) ? &vargs.front() : 0;
+			hrcode = DispInvoke(self->disp->ptr, propid, argcnt, pargs, &ret, flags);
+		}
+		Local<Value> result;
+		CComPtr<IDispatch> ptr;
+		if FAILED(hrcode) {
+			result = DispError(isolate, hrcode, L"DispInvoke", name.c_str());
+			result->ToObject()->Set(String::NewFromUtf8(isolate, "hresult"), Int32::New(isolate, hrcode));
+		}
+		else if (VariantDispGet(&ret, &ptr) && ptr) {
+			std::wstring tag;
+			tag.reserve(32);
+			tag += L"@";
+			tag += name;
+			Local<Object> parent;
+			DispInfoPtr disp_result(new DispInfo(ptr, tag, options, &self->disp));
+			result = DispObject::NodeCreate(isolate, parent, disp_result, tag);
+		}
+		else {
+			result = Variant2Result(isolate, ret, options);
+		}
+		results->Set(i, result);
+	}
+
+	if (!task) {
+		args.GetReturnValue().Set(results);
+		return;
+	}
+	Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+	args.GetReturnValue().Set(resolver->GetPromise());
+	HRESULT hrcode = task->Start(isolate, resolver);
+	if FAILED(hrcode) {
+		resolver->Reject(Win32Error(isolate, hrcode, L"DispBatch"));
+		return;
+	}
+	task.release();
+}
+
 //-------------------------------------------------------------------------------------------------------
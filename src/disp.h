@@ -7,74 +7,96 @@
 #pragma once
 
 #include "utils.h"
+#include "apartment.h"
 
 enum options_t { 
     option_none = 0, 
     option_async = 0x01, 
     option_type = 0x02,
 	option_activate = 0x04,
-	option_prepared = 0x10,
-    option_owned = 0x20,
-	option_property = 0x40,
-	option_mask = 0x0F,
+	option_eager = 0x08,
+	option_cache = 0x10,
+	option_typed = 0x20,
+	option_array_variant = 0x40,
+	option_array_ref = 0x80,
+	option_prepared = 0x10000,
+    option_owned = 0x20000,
+	option_property = 0x40000,
+	option_mask = 0xFFFF,
 	option_auto = (option_async | option_type)
 };
 
-class DispInfo {
+//-------------------------------------------------------------------------------------------------------
+
+class DispNames {
 public:
-	std::weak_ptr<DispInfo> parent;
-	CComPtr<IDispatch> ptr;
-    std::wstring name;
-	int options;
+	struct less_guid {
+		inline bool operator()(const GUID &a, const GUID &b) const { return memcmp(&a, &b, sizeof(GUID)) < 0; }
+	};
+	typedef FlatMap<std::wstring, DISPID, FlatHashNoCase, FlatEqualNoCase> names_t;
+	typedef std::map<GUID, std::shared_ptr<DispNames>, less_guid> types_t;
+	names_t names;
+
+	inline bool Find(LPOLESTR name, DISPID *dispid) const {
+		const DISPID *ptr = names.find(name);
+		if (!ptr) return false;
+		*dispid = *ptr;
+		return true;
+	}
+	inline void Add(LPOLESTR name, DISPID dispid) {
+		names[name] = dispid;
+	}
+
+	// Returns names cache shared by all dispatch objects with the same type
+	static std::shared_ptr<DispNames> Get(ITypeInfo *info);
+	static std::shared_ptr<DispNames> Get(const GUID &guid);
 
+private:
+	static types_t by_type;
+};
+
+typedef std::shared_ptr<DispNames> DispNamesPtr;
+
+//-------------------------------------------------------------------------------------------------------
+
+struct DispStats {
+	static ULONGLONG funcdesc;		// ITypeInfo::GetFuncDesc calls
+	static ULONGLONG type_hits;		// DispTypeCache lookups
+	static ULONGLONG type_misses;
+	static ULONGLONG type_evictions;
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Members description of one interface, immutable when built
+
+class DispTypeDesc {
+public:
 	struct type_t { 
 		DISPID dispid; 
 		int kind; 
 		int argcnt_get; 
-		inline type_t(DISPID dispid_, int kind_) : dispid(dispid_), kind(kind_), argcnt_get(0) {}
+		inline type_t() : dispid(DISPID_UNKNOWN), kind(0), argcnt_get(0) {}
 		inline bool is_property() const { return ((kind & INVOKE_FUNC) == 0); }
 		inline bool is_property_simple() const { return (((kind & (INVOKE_PROPERTYGET | INVOKE_FUNC))) == INVOKE_PROPERTYGET) && (argcnt_get == 0); }
+		inline void add(const FUNCDESC *desc) {
+			dispid = desc->memid;
+			kind |= desc->invkind;
+			if ((desc->invkind & INVOKE_PROPERTYGET) != 0) {
+				if (desc->cParams > argcnt_get)
+					argcnt_get = desc->cParams;
+			}
+		}
 	};
-	typedef std::shared_ptr<type_t> type_ptr;
-	typedef std::map<DISPID, type_ptr> types_by_dispid_t;
+	typedef FlatMap<DISPID, type_t> types_by_dispid_t;
 	types_by_dispid_t types_by_dispid;
 
-    inline DispInfo(IDispatch *disp, const std::wstring &nm, int opt, std::shared_ptr<DispInfo> *parnt = nullptr)
-        : ptr(disp), options(opt), name(nm)
-    { 
-        if (parnt) parent = *parnt;
-        if ((options & option_type) != 0)
-            Prepare(disp);
-    }
-
-    void Prepare(IDispatch *disp) {
-        Enumerate([this](ITypeInfo *info, FUNCDESC *desc) {
-			type_ptr &ptr = this->types_by_dispid[desc->memid];
-			if (!ptr) ptr.reset(new type_t(desc->memid, desc->invkind));
-			else ptr->kind |= desc->invkind;
-			if ((desc->invkind & INVOKE_PROPERTYGET) != 0) {
-				if (desc->cParams > ptr->argcnt_get)
-					ptr->argcnt_get = desc->cParams;
-			}
-        });
-        bool prepared = types_by_dispid.size() > 3; // QueryInterface, AddRef, Release
-        if (prepared) options |= option_prepared;
+	inline const type_t *Find(DISPID dispid) const {
+		const type_t *type = types_by_dispid.find(dispid);
+		return (type && type->kind != 0) ? type : nullptr;
 	}
 
-    template<typename T>
-    bool Enumerate(T process) {
-        UINT i, cnt;
-        if (!ptr || FAILED(ptr->GetTypeInfoCount(&cnt))) cnt = 0;
-        else for (i = 0; i < cnt; i++) {
-            CComPtr<ITypeInfo> info;
-            if (ptr->GetTypeInfo(i, 0, &info) != S_OK) continue;
-            PrepareType<T>(info, process);
-        }
-        return cnt > 0;
-    }
-
-    template<typename T>
-    bool PrepareType(ITypeInfo *info, T process) {
+	template<typename T>
+	static bool PrepareType(ITypeInfo *info, T process) {
 		UINT n = 0;
 		while (PrepareFunc<T>(info, n, process)) n++;
 		/*
@@ -86,30 +108,119 @@ public:
 		return n > 0;
 	}
 
-    template<typename T>
-	bool PrepareFunc(ITypeInfo *info, UINT n, T process) {
+	template<typename T>
+	static bool PrepareFunc(ITypeInfo *info, UINT n, T process) {
 		FUNCDESC *desc;
+		DispStats::funcdesc++;
 		if (info->GetFuncDesc(n, &desc) != S_OK) return false;
-        process(info, desc);
+		process(info, desc);
 		info->ReleaseFuncDesc(desc);
 		return true;
 	}
+};
+
+typedef std::shared_ptr<const DispTypeDesc> DispTypeDescPtr;
+
+//-------------------------------------------------------------------------------------------------------
+// Process wide type descriptions by interface GUID and LCID, least recently used are evicted
+
+class DispTypeCache {
+public:
+	static DispTypeDescPtr Find(const GUID &guid, LCID lcid);
+	static DispTypeDescPtr Get(ITypeInfo *info, LCID lcid);
+	static void SetCapacity(size_t cnt);
+	static inline size_t GetCapacity() { return capacity; }
+	static inline size_t GetSize() { return items.size(); }
+
+private:
+	struct key_t {
+		GUID guid;
+		LCID lcid;
+		inline bool operator<(const key_t &k) const {
+			int rc = memcmp(&guid, &k.guid, sizeof(GUID));
+			return (rc != 0) ? (rc < 0) : (lcid < k.lcid);
+		}
+	};
+	typedef std::list<key_t> order_t;
+	struct item_t {
+		DispTypeDescPtr desc;
+		order_t::iterator pos;
+	};
+	typedef std::map<key_t, item_t> items_t;
+
+	static items_t items;
+	static order_t order;
+	static size_t capacity;
+	static void Shrink();
+};
+
+//-------------------------------------------------------------------------------------------------------
+
+class DispInfo {
+public:
+	std::weak_ptr<DispInfo> parent;
+	CComPtr<IDispatch> ptr;
+    std::wstring name;
+	int options;
+
+	// Name lookup results: typed members are shared by type, other names are cached per object
+	DispNamesPtr type_names;
+	DispNames names;
+
+	// Complete description shared by type or members resolved by this object on demand (lazy mode)
+	typedef DispTypeDesc::type_t type_t;
+	DispTypeDescPtr type_desc;
+	DispTypeDesc::types_by_dispid_t types_by_dispid;
+
+	// Lazy mode keeps type information and resolves members on demand
+	CComPtr<ITypeInfo> type_info;
+	CComPtr<ITypeInfo2> type_info2;
+	bool type_loaded;
+	GUID type_guid;
+
+	// Object owned by dedicated apartment thread, ptr is a proxy then
+	std::shared_ptr<DispHome> home;
+
+    inline DispInfo(IDispatch *disp, const std::wstring &nm, int opt, std::shared_ptr<DispInfo> *parnt = nullptr)
+        : ptr(disp), options(opt & option_mask), name(nm), type_loaded(false)
+    { 
+        type_guid = GUID_NULL;
+        if (parnt) {
+            parent = *parnt;
+            if (parent->home) home.reset(new DispHome(parent->home->apartment, nullptr));
+        }
+        if ((options & (option_type | option_eager)) == (option_type | option_eager))
+            Prepare(disp);
+    }
+
+    void Prepare(IDispatch *disp);
+    bool LoadTypeInfo();
+
+    template<typename T>
+    bool Enumerate(T process) {
+        UINT i, cnt;
+        if (!ptr || FAILED(ptr->GetTypeInfoCount(&cnt))) cnt = 0;
+        else for (i = 0; i < cnt; i++) {
+            CComPtr<ITypeInfo> info;
+            if (ptr->GetTypeInfo(i, 0, &info) != S_OK) continue;
+            DispTypeDesc::PrepareType<T>(info, process);
+        }
+        return cnt > 0;
+    }
+
     inline bool GetItemName(ITypeInfo *info, DISPID dispid, BSTR *name) {
         UINT cnt_ret;
         return info->GetNames(dispid, name, 1, &cnt_ret) == S_OK && cnt_ret > 0;
     }
 
-	inline bool GetTypeInfo(const DISPID dispid, type_ptr &info) {
-		if ((options & option_prepared) == 0) return false;
-		types_by_dispid_t::const_iterator it = types_by_dispid.find(dispid);
-		if (it == types_by_dispid.end()) return false;
-		info = it->second;
-		return true;
+	inline const type_t *GetTypeInfo(const DISPID dispid) {
+		if (!LoadTypeInfo()) return nullptr;
+		if (type_desc) return type_desc->Find(dispid);
+		return ResolveType(dispid);
 	}
 
-	HRESULT FindProperty(LPOLESTR name, DISPID *dispid) {
-		return DispFind(ptr, name, dispid);
-	}
+	const type_t *ResolveType(DISPID dispid);
+	HRESULT FindProperty(LPOLESTR name, DISPID *dispid);
 
 	HRESULT GetProperty(DISPID dispid, LONG argcnt, VARIANT *args, VARIANT *value) {
 		HRESULT hrcode = DispInvoke(ptr, dispid, argcnt, args, value, DISPATCH_PROPERTYGET);
@@ -139,12 +250,25 @@ typedef std::shared_ptr<DispInfo> DispInfoPtr;
 
 class DispObject: public ObjectWrap
 {
+	friend class DispTask;
 public:
 	DispObject(const DispInfoPtr &ptr, const std::wstring &name, DISPID id = DISPID_UNKNOWN, LONG indx = -1, int opt = 0);
 	~DispObject();
 
 	static Persistent<ObjectTemplate> inst_template;
 	static Persistent<FunctionTemplate> clazz_template;
+	static Persistent<FunctionTemplate> valueof_template;
+	static Persistent<FunctionTemplate> tostring_template;
+
+	// Typed objects are created by templates with accessors of simple properties, so V8 caches access to them
+	typedef std::map<GUID, Persistent<ObjectTemplate>*, DispNames::less_guid> templates_t;
+	static templates_t typed_templates;
+	static bool accessors;
+
+	// Special property names, internalized once and matched by identity
+	enum special_t { special_value, special_id, special_type, special_proto, special_valueof, special_tostring, special_count };
+	static Persistent<String> special_names[special_count];
+	static int GetSpecial(const Local<String> &name);
 	static void NodeInit(const Local<Object> &target);
 	static bool HasInstance(Isolate *isolate, const Local<Value> &obj) {
 		Local<FunctionTemplate> clazz = clazz_template.Get(isolate);
@@ -156,6 +280,7 @@ public:
 		DispObject *self = Unwrap<DispObject>(obj);
 		return self && SUCCEEDED(self->valueOf(isolate, value));
 	}
+	static bool GetDispatch(Isolate *isolate, const Local<Value> &obj, IDispatch **disp);
 	static Local<Object> NodeCreate(Isolate *isolate, IDispatch *disp, const std::wstring &name, int opt) {
 		Local<Object> parent;
 		DispInfoPtr ptr(new DispInfo(disp, name, opt));
@@ -169,21 +294,43 @@ private:
 	static void NodeValueOf(const FunctionCallbackInfo<Value> &args);
 	static void NodeToString(const FunctionCallbackInfo<Value> &args);
 	static void NodeRelease(const FunctionCallbackInfo<Value> &args);
+	static void NodeStats(const FunctionCallbackInfo<Value> &args);
+	static void NodeConfigure(const FunctionCallbackInfo<Value> &args);
+	static void NodeFetchRows(const FunctionCallbackInfo<Value> &args);
+	static void NodeCallAsync(const FunctionCallbackInfo<Value> &args);
+	static void NodeGetAsync(const FunctionCallbackInfo<Value> &args);
+	static void NodeSetAsync(const FunctionCallbackInfo<Value> &args);
+	static void NodeInvokeAsync(const FunctionCallbackInfo<Value> &args, WORD flags);
+	static void NodeBatch(const FunctionCallbackInfo<Value> &args);
+	static void NodeIterator(const FunctionCallbackInfo<Value> &args);
+	static void NodeAsyncIterator(const FunctionCallbackInfo<Value> &args);
+	static void NodeEnumerate(const FunctionCallbackInfo<Value> &args, bool async);
 	static void NodeGet(Local<String> name, const PropertyCallbackInfo<Value> &args);
 	static void NodeSet(Local<String> name, Local<Value> value, const PropertyCallbackInfo<Value> &args);
+	static void NodeGetNamed(Local<Name> name, const PropertyCallbackInfo<Value> &args);
+	static void NodeSetNamed(Local<Name> name, Local<Value> value, const PropertyCallbackInfo<Value> &args);
+	static void NodeGetTyped(Local<String> name, const PropertyCallbackInfo<Value> &args);
+	static void NodeSetTyped(Local<String> name, Local<Value> value, const PropertyCallbackInfo<void> &args);
 	static void NodeGetByIndex(uint32_t index, const PropertyCallbackInfo<Value> &args);
 	static void NodeSetByIndex(uint32_t index, Local<Value> value, const PropertyCallbackInfo<Value> &args);
 	static void NodeCall(const FunctionCallbackInfo<Value> &args);
 
+	static void ConfigureTemplate(Isolate *isolate, Local<ObjectTemplate> &inst, bool typed);
+	static Local<ObjectTemplate> GetTemplate(Isolate *isolate, const DispInfoPtr &ptr);
+
 protected:
 	bool release();
-	bool get(LPOLESTR tag, LONG index, const PropertyCallbackInfo<Value> &args);
-	bool set(LPOLESTR tag, LONG index, const Local<Value> &value, const PropertyCallbackInfo<Value> &args);
+
+	// Known DISPID (typed accessors) skips name lookup
+	bool get(LPOLESTR tag, DISPID propid, LONG index, const PropertyCallbackInfo<Value> &args);
+	template<typename T>
+	bool set(LPOLESTR tag, DISPID propid, LONG index, const Local<Value> &value, const PropertyCallbackInfo<T> &args);
 	void call(Isolate *isolate, const FunctionCallbackInfo<Value> &args);
 
 	HRESULT valueOf(Isolate *isolate, VARIANT &value);
 	HRESULT valueOf(Isolate *isolate, const Local<Object> &self, Local<Value> &value);
 	void toString(const FunctionCallbackInfo<Value> &args);
+	HRESULT getEnumerator(IEnumVARIANT **result);
     Local<Value> getIdentity(Isolate *isolate);
     Local<Value> getTypeInfo(Isolate *isolate);
 
@@ -200,4 +347,20 @@ private:
 	LONG index;
 
 	HRESULT prepare();
+
+	// Weak references to objects returned by properties, keyed by DISPID and object identity (option_cache),
+	// and to method wrappers, keyed by DISPID and null
+	typedef std::pair<DISPID, IUnknown*> child_key_t;
+	struct child_t {
+		DispObject *owner;
+		child_key_t key;
+		Persistent<Object> obj;
+	};
+	typedef std::map<child_key_t, child_t*> children_t;
+	children_t children;
+
+	bool findChild(Isolate *isolate, const child_key_t &key, Local<Object> &result);
+	void addChild(Isolate *isolate, const child_key_t &key, const Local<Object> &obj);
+	void clearChildren();
+	static void NodeChildWeak(const WeakCallbackInfo<child_t> &data);
 };
@@ -0,0 +1,143 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispEnumerator class implementations
+//-------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "enum.h"
+
+Persistent<ObjectTemplate> DispEnumerator::inst_template;
+Persistent<String> DispEnumerator::value_name;
+Persistent<String> DispEnumerator::done_name;
+
+// First batch is small for short collections, long enumerations double it up to the limit
+static const ULONG enum_batch_first = 8;
+static const ULONG enum_batch_max = 256;
+
+//-------------------------------------------------------------------------------------------------------
+// DispEnumerator implemetation
+
+DispEnumerator::DispEnumerator(IEnumVARIANT *enm, int opt, bool asnc)
+	: ptr(enm), options(opt), async(asnc), pos(0), count(0), batch(enum_batch_first), last(false), single(false) {
+}
+
+DispEnumerator::~DispEnumerator() {
+	Close();
+}
+
+HRESULT DispEnumerator::Fetch() {
+	if (items.size() < batch) {
+		VARIANT empty;
+		empty.vt = VT_EMPTY;
+		items.resize(batch, empty);
+	}
+	ULONG fetched = 0;
+	HRESULT hrcode = ptr->Next(batch, &items[0], &fetched);
+
+	// Some enumerators do not support batches, they are read item by item
+	if (FAILED(hrcode) && batch > 1) {
+		batch = 1;
+		single = true;
+		hrcode = ptr->Next(batch, &items[0], &fetched);
+	}
+	pos = 0;
+	count = SUCCEEDED(hrcode) ? fetched : 0;
+	last = FAILED(hrcode) || hrcode == S_FALSE || fetched == 0;
+	if (!single && batch < enum_batch_max) batch *= 2;
+	return hrcode;
+}
+
+void DispEnumerator::Close() {
+	for (ULONG i = pos; i < count; i++) VariantClear(&items[i]);
+	pos = count = 0;
+	last = true;
+	ptr.Release();
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+void DispEnumerator::NodeInit(Isolate *isolate) {
+	Local<FunctionTemplate> clazz = FunctionTemplate::New(isolate);
+	clazz->SetClassName(String::NewFromUtf8(isolate, "Enumerator"));
+	NODE_SET_PROTOTYPE_METHOD(clazz, "next", NodeNext);
+	NODE_SET_PROTOTYPE_METHOD(clazz, "return", NodeReturn);
+
+	// Iterators are iterable themselves
+	Local<Symbol> sym;
+	if (GetWellKnownSymbol(isolate, "iterator", sym)) clazz->PrototypeTemplate()->Set(sym, FunctionTemplate::New(isolate, NodeSelf));
+	if (GetWellKnownSymbol(isolate, "asyncIterator", sym)) clazz->PrototypeTemplate()->Set(sym, FunctionTemplate::New(isolate, NodeSelf));
+
+	Local<ObjectTemplate> &inst = clazz->InstanceTemplate();
+	inst->SetInternalFieldCount(1);
+	inst_template.Reset(isolate, inst);
+	value_name.Reset(isolate, String::NewFromUtf8(isolate, "value", String::kInternalizedString));
+	done_name.Reset(isolate, String::NewFromUtf8(isolate, "done", String::kInternalizedString));
+}
+
+Local<Object> DispEnumerator::NodeCreate(Isolate *isolate, IEnumVARIANT *enm, int opt, bool asnc) {
+	Local<Object> self;
+	if (!inst_template.IsEmpty()) {
+		self = inst_template.Get(isolate)->NewInstance();
+		(new DispEnumerator(enm, opt, asnc))->Wrap(self);
+	}
+	return self;
+}
+
+void DispEnumerator::NodeResult(const FunctionCallbackInfo<Value> &args, DispEnumerator *self, const Local<Value> &value, bool done) {
+	Isolate *isolate = args.GetIsolate();
+	Local<Object> result = Object::New(isolate);
+	result->Set(value_name.Get(isolate), value);
+	result->Set(done_name.Get(isolate), Boolean::New(isolate, done));
+	if (self && self->async) {
+		Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+		resolver->Resolve(result);
+		args.GetReturnValue().Set(resolver->GetPromise());
+	}
+	else {
+		args.GetReturnValue().Set(result);
+	}
+}
+
+void DispEnumerator::NodeNext(const FunctionCallbackInfo<Value> &args) {
+	Isolate *isolate = args.GetIsolate();
+	DispEnumerator *self = DispEnumerator::Unwrap<DispEnumerator>(args.This());
+	if (!self) {
+		isolate->ThrowException(DispErrorInvalid(isolate));
+		return;
+	}
+	HRESULT hrcode = S_OK;
+	if (self->pos >= self->count && !self->last && self->ptr) hrcode = self->Fetch();
+	if (self->pos >= self->count) {
+		self->Close();
+		if FAILED(hrcode) {
+			Local<Value> err = Win32Error(isolate, hrcode, L"DispEnumNext");
+			if (!self->async) isolate->ThrowException(err);
+			else {
+				Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+				resolver->Reject(err);
+				args.GetReturnValue().Set(resolver->GetPromise());
+			}
+			return;
+		}
+		NodeResult(args, self, Undefined(isolate), true);
+		return;
+	}
+	VARIANT &item = self->items[self->pos++];
+	Local<Value> value = Variant2Value(isolate, item, true, self->options);
+	VariantClear(&item);
+	NodeResult(args, self, value, false);
+}
+
+void DispEnumerator::NodeReturn(const FunctionCallbackInfo<Value> &args) {
+	Isolate *isolate = args.GetIsolate();
+	DispEnumerator *self = DispEnumerator::Unwrap<DispEnumerator>(args.This());
+	if (self) self->Close();
+	NodeResult(args, self, (args.Length() > 0) ? args[0] : Local<Value>::Cast(Undefined(isolate)), true);
+}
+
+void DispEnumerator::NodeSelf(const FunctionCallbackInfo<Value> &args) {
+	args.GetReturnValue().Set(args.This());
+}
+
+//-------------------------------------------------------------------------------------------------------
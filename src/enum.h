@@ -0,0 +1,43 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispEnumerator class declarations. JS iterator protocol over IEnumVARIANT
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "disp.h"
+
+//-------------------------------------------------------------------------------------------------------
+
+class DispEnumerator: public ObjectWrap {
+public:
+	DispEnumerator(IEnumVARIANT *enm, int opt, bool asnc);
+	~DispEnumerator();
+
+	static void NodeInit(Isolate *isolate);
+	static Local<Object> NodeCreate(Isolate *isolate, IEnumVARIANT *enm, int opt, bool asnc);
+
+private:
+	CComPtr<IEnumVARIANT> ptr;
+	int options;
+	bool async;
+
+	// Items are prefetched in growing batches into reused buffer, items [pos, count) are not yielded yet
+	std::vector<VARIANT> items;
+	ULONG pos, count, batch;
+	bool last;
+	bool single;	// enumerator failed batched Next, items are read one by one
+
+	HRESULT Fetch();
+	void Close();
+
+	static Persistent<ObjectTemplate> inst_template;
+	static Persistent<String> value_name, done_name;
+	static void NodeNext(const FunctionCallbackInfo<Value> &args);
+	static void NodeReturn(const FunctionCallbackInfo<Value> &args);
+	static void NodeSelf(const FunctionCallbackInfo<Value> &args);
+	static void NodeResult(const FunctionCallbackInfo<Value> &args, DispEnumerator *self, const Local<Value> &value, bool done);
+};
+
+//-------------------------------------------------------------------------------------------------------
@@ -0,0 +1,154 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: Open addressing hash table with inline storage, used for DISPID and member name lookups
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------
+
+struct FlatHash {
+	inline size_t operator()(int32_t key) const {
+		uint32_t h = (uint32_t)key;
+		h ^= h >> 16; h *= 0x85ebca6b;
+		h ^= h >> 13; h *= 0xc2b2ae35;
+		h ^= h >> 16;
+		return h;
+	}
+	inline size_t operator()(const std::wstring &key) const {
+		return (*this)(key.c_str());
+	}
+	inline size_t operator()(const wchar_t *key) const {
+		uint32_t h = 2166136261u;
+		while (*key) { h ^= (uint32_t)*key++; h *= 16777619u; }
+		return h;
+	}
+};
+
+struct FlatEqual {
+	inline bool operator()(int32_t a, int32_t b) const { return a == b; }
+	inline bool operator()(const std::wstring &a, const std::wstring &b) const { return a == b; }
+	inline bool operator()(const std::wstring &a, const wchar_t *b) const { return wcscmp(a.c_str(), b) == 0; }
+};
+
+// COM member names are case insensitive
+struct FlatHashNoCase {
+	inline size_t operator()(const std::wstring &key) const {
+		return (*this)(key.c_str());
+	}
+	inline size_t operator()(const wchar_t *key) const {
+		uint32_t h = 2166136261u;
+		while (*key) {
+			wchar_t c = *key++;
+			if (c >= L'A' && c <= L'Z') c += (L'a' - L'A');
+			else if (c >= 0x80) c = towlower(c);
+			h ^= (uint32_t)c; h *= 16777619u;
+		}
+		return h;
+	}
+};
+
+struct FlatEqualNoCase {
+	inline bool operator()(const std::wstring &a, const std::wstring &b) const { return _wcsicmp(a.c_str(), b.c_str()) == 0; }
+	inline bool operator()(const std::wstring &a, const wchar_t *b) const { return _wcsicmp(a.c_str(), b) == 0; }
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Keys and values are stored inline in one array, linear probing, no erase (tables only grow or get cleared)
+
+template <typename K, typename V, typename HASH = FlatHash, typename EQUAL = FlatEqual>
+class FlatMap {
+public:
+	struct slot_t {
+		K key;
+		V value;
+		bool used;
+		inline slot_t() : used(false) {}
+	};
+
+	inline FlatMap() : count(0) {}
+
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	inline void clear() { slots.clear(); count = 0; }
+
+	template <typename KEY>
+	inline V *find(const KEY &key) {
+		return const_cast<V*>(static_cast<const FlatMap*>(this)->find(key));
+	}
+
+	template <typename KEY>
+	inline const V *find(const KEY &key) const {
+		if (count == 0) return nullptr;
+		size_t mask = slots.size() - 1;
+		for (size_t i = HASH()(key) & mask; ; i = (i + 1) & mask) {
+			const slot_t &slot = slots[i];
+			if (!slot.used) return nullptr;
+			if (EQUAL()(slot.key, key)) return &slot.value;
+		}
+	}
+
+	// Returns existing or default constructed value, references are invalidated by next insert
+	inline V &operator[](const K &key) {
+		bool inserted;
+		return insert(key, inserted);
+	}
+
+	inline V &insert(const K &key, bool &inserted) {
+		if ((count + 1) * 4 > slots.size() * 3) grow();
+		size_t mask = slots.size() - 1;
+		for (size_t i = HASH()(key) & mask; ; i = (i + 1) & mask) {
+			slot_t &slot = slots[i];
+			if (!slot.used) {
+				slot.key = key;
+				slot.used = true;
+				count++;
+				inserted = true;
+				return slot.value;
+			}
+			if (EQUAL()(slot.key, key)) {
+				inserted = false;
+				return slot.value;
+			}
+		}
+	}
+
+	template <typename T>
+	inline void for_each(T process) const {
+		for (const slot_t &slot : slots) {
+			if (slot.used) process(slot.key, slot.value);
+		}
+	}
+
+	inline void reserve(size_t cnt) {
+		size_t cap = slots.empty() ? 8 : slots.size();
+		while (cnt * 4 > cap * 3) cap *= 2;
+		if (cap > slots.size()) rehash(cap);
+	}
+
+private:
+	std::vector<slot_t> slots;
+	size_t count;
+
+	inline void grow() {
+		rehash(slots.empty() ? 8 : slots.size() * 2);
+	}
+
+	void rehash(size_t cap) {
+		std::vector<slot_t> old(cap);
+		old.swap(slots);
+		size_t mask = cap - 1;
+		for (slot_t &src : old) {
+			if (!src.used) continue;
+			size_t i = HASH()(src.key) & mask;
+			while (slots[i].used) i = (i + 1) & mask;
+			slot_t &dst = slots[i];
+			dst.key = std::move(src.key);
+			dst.value = std::move(src.value);
+			dst.used = true;
+		}
+	}
+};
+
+//-------------------------------------------------------------------------------------------------------
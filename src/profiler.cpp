@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispProfiler class implementations
+//-------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "disp.h"
+#include "profiler.h"
+
+bool DispProfiler::enabled = false;
+FlatMap<DispProfiler::key_t, DispProfiler::entry_t, DispProfiler::key_hash, DispProfiler::key_equal> DispProfiler::entries;
+LONGLONG DispProfiler::frequency = 0;
+
+//-------------------------------------------------------------------------------------------------------
+// DispProfiler implemetation
+
+void DispProfiler::Record(kind_t kind, const std::wstring &object, DISPID dispid, LPCOLESTR member, HRESULT hrcode, LONGLONG started) {
+	LONGLONG ticks = Now() - started;
+	key_ref_t ref = { kind, dispid, object };
+	entry_t *entry = entries.find(ref);
+	if (!entry) {
+		key_t key = { kind, dispid, object };
+		entry = &entries[key];
+		if (member) entry->member = member;
+	}
+	entry->count++;
+	entry->ticks += ticks;
+	if (ticks > entry->max_ticks) entry->max_ticks = ticks;
+	if (frequency == 0) {
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		frequency = freq.QuadPart;
+	}
+	ULONGLONG us = (ULONGLONG)ticks * 1000000 / frequency;
+	int bucket = 0;
+	while (us > 0 && bucket < histogram_size - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	entry->histogram[bucket]++;
+	if FAILED(hrcode) {
+		entry->failures++;
+		entry->hresults[hrcode]++;
+	}
+}
+
+Local<Array> DispProfiler::Dump(Isolate *isolate) {
+	static const char *kinds[] = { "get", "set", "call" };
+	Local<Array> result = Array::New(isolate);
+	uint32_t cnt = 0;
+	double scale = (frequency > 0) ? 1000000.0 / frequency : 0;
+	entries.for_each([&](const key_t &key, const entry_t &value) {
+		const entry_t *entry = &value;
+		Local<Object> item = Object::New(isolate);
+		item->Set(String::NewFromUtf8(isolate, "object"), String::NewFromTwoByte(isolate, (const uint16_t*)key.object.c_str()));
+		item->Set(String::NewFromUtf8(isolate, "member"), String::NewFromTwoByte(isolate, (const uint16_t*)entry->member.c_str()));
+		item->Set(String::NewFromUtf8(isolate, "dispid"), Int32::New(isolate, key.dispid));
+		item->Set(String::NewFromUtf8(isolate, "type"), String::NewFromUtf8(isolate, kinds[key.kind]));
+		item->Set(String::NewFromUtf8(isolate, "count"), Number::New(isolate, (double)entry->count));
+		item->Set(String::NewFromUtf8(isolate, "failures"), Number::New(isolate, (double)entry->failures));
+		item->Set(String::NewFromUtf8(isolate, "time"), Number::New(isolate, entry->ticks * scale));
+		item->Set(String::NewFromUtf8(isolate, "maxTime"), Number::New(isolate, entry->max_ticks * scale));
+		Local<Array> histogram = Array::New(isolate, histogram_size);
+		for (uint32_t b = 0; b < histogram_size; b++) histogram->Set(b, Number::New(isolate, (double)entry->histogram[b]));
+		item->Set(String::NewFromUtf8(isolate, "histogram"), histogram);
+		Local<Object> hresults = Object::New(isolate);
+		for (std::map<HRESULT, ULONGLONG>::const_iterator it = entry->hresults.begin(); it != entry->hresults.end(); ++it) {
+			char code[16];
+			sprintf_s(code, "0x%08X", (ULONG)it->first);
+			hresults->Set(String::NewFromUtf8(isolate, code), Number::New(isolate, (double)it->second));
+		}
+		item->Set(String::NewFromUtf8(isolate, "hresults"), hresults);
+		result->Set(cnt++, item);
+	});
+	return result;
+}
+
+void DispProfiler::Reset() {
+	entries.clear();
+}
+
+//-------------------------------------------------------------------------------------------------------
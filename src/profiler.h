@@ -0,0 +1,70 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispProfiler class declarations. Optional per-member counters of dispatch calls
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------
+// Calls are counted by the main thread only, so counters are plain and no locks are taken
+
+class DispProfiler {
+public:
+	enum kind_t { kind_get = 0, kind_set, kind_call };
+	enum { histogram_size = 16 };	// latency buckets: < 1us, < 2us, < 4us, ... >= 16ms
+
+	static bool enabled;
+
+	static inline LONGLONG Now() {
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return now.QuadPart;
+	}
+
+	// Member is named by object name (as in __id) and DISPID, member name is kept from the first call
+	static void Record(kind_t kind, const std::wstring &object, DISPID dispid, LPCOLESTR member, HRESULT hrcode, LONGLONG started);
+
+	static Local<Array> Dump(Isolate *isolate);
+	static void Reset();
+
+private:
+
+	// Member is keyed by kind, DISPID and object name
+	struct key_t {
+		kind_t kind;
+		DISPID dispid;
+		std::wstring object;
+	};
+
+	// Lookup by reference, object name is copied only when the member is recorded first time
+	struct key_ref_t {
+		kind_t kind;
+		DISPID dispid;
+		const std::wstring &object;
+	};
+	struct key_hash {
+		inline size_t operator()(const key_t &key) const { return hash(key.kind, key.dispid, key.object); }
+		inline size_t operator()(const key_ref_t &key) const { return hash(key.kind, key.dispid, key.object); }
+		static inline size_t hash(kind_t kind, DISPID dispid, const std::wstring &object) { return FlatHash()(object) ^ FlatHash()((int32_t)(dispid * 4 + kind)); }
+	};
+	struct key_equal {
+		inline bool operator()(const key_t &a, const key_t &b) const { return a.dispid == b.dispid && a.kind == b.kind && a.object == b.object; }
+		inline bool operator()(const key_t &a, const key_ref_t &b) const { return a.dispid == b.dispid && a.kind == b.kind && a.object == b.object; }
+	};
+	struct entry_t {
+		std::wstring member;
+		ULONGLONG count;
+		ULONGLONG failures;
+		LONGLONG ticks;
+		LONGLONG max_ticks;
+		ULONGLONG histogram[histogram_size];
+		std::map<HRESULT, ULONGLONG> hresults;
+		inline entry_t() : count(0), failures(0), ticks(0), max_ticks(0) { memset(histogram, 0, sizeof(histogram)); }
+	};
+
+	static FlatMap<key_t, entry_t, key_hash, key_equal> entries;
+	static LONGLONG frequency;
+};
+
+//-------------------------------------------------------------------------------------------------------
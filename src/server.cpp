@@ -0,0 +1,307 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispTestServer class implementations
+//-------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "server.h"
+
+//-------------------------------------------------------------------------------------------------------
+// DispTestServer implemetation
+
+ULONGLONG DispTestServer::lookups = 0;
+
+DispTestServer::member_t &DispTestServer::AddMember(const std::wstring &name) {
+	bool inserted;
+	DISPID &dispid = names.insert(name, inserted);
+	if (!inserted) return members[dispid - 1];
+	members.push_back(member_t());
+	dispid = (DISPID)members.size();
+	members.back().name = name;
+	return members.back();
+}
+
+// Values of JS arrays are SAFEARRAY of variants, they are converted item by item (one dimension)
+HRESULT DispTestServer::ChangeType(VARIANT &value, VARTYPE vt) {
+	if ((vt & VT_ARRAY) == 0) return VariantChangeType(&value, &value, 0, vt);
+	if (value.vt != (VT_ARRAY | VT_VARIANT) || !value.parray || SafeArrayGetDim(value.parray) != 1) return DISP_E_TYPEMISMATCH;
+	VARTYPE type = (vt & VT_TYPEMASK);
+	LONG lbound = 0, ubound = -1;
+	SafeArrayGetLBound(value.parray, 1, &lbound);
+	SafeArrayGetUBound(value.parray, 1, &ubound);
+	SAFEARRAY *arr = SafeArrayCreateVector(type, lbound, (ULONG)(ubound - lbound + 1));
+	if (!arr) return E_OUTOFMEMORY;
+	HRESULT hrcode = S_OK;
+	for (LONG i = lbound; SUCCEEDED(hrcode) && i <= ubound; i++) {
+		CComVariant item, tmp;
+		hrcode = SafeArrayGetElement(value.parray, &i, &item);
+		if SUCCEEDED(hrcode) hrcode = VariantChangeType(&tmp, &item, 0, type);
+		if FAILED(hrcode) break;
+		void *data = (type == VT_VARIANT) ? (void*)&tmp : (type == VT_BSTR || type == VT_DISPATCH || type == VT_UNKNOWN) ? (void*)tmp.byref : (void*)&tmp.lVal;
+		hrcode = SafeArrayPutElement(arr, &i, data);
+	}
+	if FAILED(hrcode) {
+		SafeArrayDestroy(arr);
+		return hrcode;
+	}
+	VariantClear(&value);
+	value.vt = vt;
+	value.parray = arr;
+	return S_OK;
+}
+
+// Busy wait imitates out-of-process call without giving up the thread
+void DispTestServer::Wait() {
+	if (latency == 0) return;
+	LARGE_INTEGER freq, now, end;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&end);
+	end.QuadPart += freq.QuadPart * latency / 1000000;
+	do QueryPerformanceCounter(&now);
+	while (now.QuadPart < end.QuadPart);
+}
+
+// Properties have get and put functions, methods take any arguments and return VARIANT
+HRESULT DispTestServer::BuildTypeInfo(const GUID &guid) {
+	static PARAMDATA value_param = { (OLECHAR*)L"value", VT_VARIANT };
+	std::vector<METHODDATA> funcs;
+	funcs.reserve(members.size() * 2);
+	for (size_t i = 0; i < members.size(); i++) {
+		const member_t &member = members[i];
+		METHODDATA func = { (OLECHAR*)member.name.c_str(), nullptr, (DISPID)(i + 1), (UINT)funcs.size(), CC_STDCALL, 0, DISPATCH_METHOD, VT_VARIANT };
+		if (!member.method) {
+			func.wFlags = DISPATCH_PROPERTYGET;
+			funcs.push_back(func);
+			func.iMeth = (UINT)funcs.size();
+			func.ppdata = &value_param;
+			func.cArgs = 1;
+			func.wFlags = DISPATCH_PROPERTYPUT;
+			func.vtReturn = VT_EMPTY;
+		}
+		funcs.push_back(func);
+	}
+	INTERFACEDATA data = { funcs.empty() ? nullptr : &funcs[0], (UINT)funcs.size() };
+
+	// Created type information is a coclass, members are described by its interface
+	CComPtr<ITypeInfo> coclass;
+	HREFTYPE href;
+	HRESULT hrcode = CreateDispTypeInfo(&data, LOCALE_SYSTEM_DEFAULT, &coclass);
+	if SUCCEEDED(hrcode) hrcode = coclass->GetRefTypeOfImplType(0, &href);
+	if SUCCEEDED(hrcode) hrcode = coclass->GetRefTypeInfo(href, &type_info);
+	if (SUCCEEDED(hrcode) && guid != GUID_NULL) type_info = new DispTestTypeInfo(type_info, guid);
+	return hrcode;
+}
+
+HRESULT STDMETHODCALLTYPE DispTestServer::GetTypeInfo(UINT iTInfo, LCID lcid, ITypeInfo **ppTInfo) {
+	if (!ppTInfo) return E_POINTER;
+	if (iTInfo != 0 || !type_info) return DISP_E_BADINDEX;
+	*ppTInfo = type_info;
+	type_info.p->AddRef();
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DispTestServer::GetIDsOfNames(REFIID riid, LPOLESTR *rgszNames, UINT cNames, LCID lcid, DISPID *rgDispId) {
+	lookups++;
+	if (cNames != 1 || !rgszNames[0]) return DISP_E_UNKNOWNNAME;
+	const DISPID *dispid = names.find(rgszNames[0]);
+	if (!dispid) {
+		*rgDispId = DISPID_UNKNOWN;
+		return DISP_E_UNKNOWNNAME;
+	}
+	*rgDispId = *dispid;
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DispTestServer::Invoke(DISPID dispIdMember, REFIID riid, LCID lcid, WORD wFlags, DISPPARAMS *pDispParams, VARIANT *pVarResult, EXCEPINFO *pExcepInfo, UINT *puArgErr) {
+	Wait();
+	UINT argcnt = pDispParams ? pDispParams->cArgs : 0;
+	VARIANT *args = pDispParams ? pDispParams->rgvarg : nullptr;	// reverse order
+	if (dispIdMember == DISPID_VALUE) {
+		if (argcnt == 0) return DISP_E_MEMBERNOTFOUND;
+		LONG index = Variant2Int<LONG>(args[argcnt - 1], -1);
+		if (index < 0 || index >= (LONG)items.size()) return DISP_E_BADINDEX;
+		if ((wFlags & (DISPATCH_PROPERTYPUT | DISPATCH_PROPERTYPUTREF)) != 0) {
+			return (argcnt < 2) ? DISP_E_BADPARAMCOUNT : VariantCopyInd(&items[index], &args[0]);
+		}
+		return pVarResult ? VariantCopyInd(pVarResult, &items[index]) : S_OK;
+	}
+	if (dispIdMember == DISPID_NEWENUM) {
+		if (!pVarResult) return E_INVALIDARG;
+		pVarResult->vt = VT_UNKNOWN;
+		pVarResult->punkVal = new DispTestEnum(items);
+		pVarResult->punkVal->AddRef();
+		return S_OK;
+	}
+	if (dispIdMember < 1 || dispIdMember > (DISPID)members.size()) return DISP_E_MEMBERNOTFOUND;
+	member_t &member = members[dispIdMember - 1];
+	if FAILED(member.error) return member.error;
+	if ((wFlags & (DISPATCH_PROPERTYPUT | DISPATCH_PROPERTYPUTREF)) != 0) {
+		if (member.method) return DISP_E_MEMBERNOTFOUND;
+		if (argcnt < 1) return DISP_E_BADPARAMCOUNT;
+		return VariantCopyInd(&member.value, &args[0]);
+	}
+	if (member.define) {
+		if (argcnt < 2) return DISP_E_BADPARAMCOUNT;
+		CComVariant name;
+		HRESULT hrcode = VariantChangeType(&name, &args[argcnt - 1], 0, VT_BSTR);
+		if FAILED(hrcode) return hrcode;
+		std::wstring member_name(name.bstrVal ? name.bstrVal : L"");
+		return VariantCopyInd(&AddMember(member_name).value, &args[argcnt - 2]);
+	}
+	if (!pVarResult) return S_OK;
+	if (member.echo) return (argcnt > 0) ? VariantCopyInd(pVarResult, &args[argcnt - 1]) : S_OK;
+	return VariantCopy(pVarResult, &member.value);
+}
+
+void DispTestServer::NodeCreate(const FunctionCallbackInfo<Value> &args) {
+	Isolate *isolate = args.GetIsolate();
+	if (args.Length() < 1 || !args[0]->IsObject()) {
+		isolate->ThrowException(InvalidArgumentsError(isolate));
+		return;
+	}
+	Local<Object> spec = args[0]->ToObject();
+	CComPtr<DispTestServer> server(new DispTestServer());
+
+	Local<Value> val = spec->Get(String::NewFromUtf8(isolate, "properties"));
+	if (!val.IsEmpty() && val->IsObject()) {
+		Local<Object> props = val->ToObject();
+		Local<Array> keys = props->GetOwnPropertyNames();
+		for (uint32_t i = 0; i < keys->Length(); i++) {
+			Local<Value> key = keys->Get(i), value = props->Get(key);
+			String::Value vkey(key);
+			member_t &member = server->AddMember((LPOLESTR)*vkey);
+			Value2Variant(isolate, value, member.value);
+		}
+	}
+
+	// Methods without result (undefined or null) return their first argument
+	val = spec->Get(String::NewFromUtf8(isolate, "methods"));
+	if (!val.IsEmpty() && val->IsObject()) {
+		Local<Object> methods = val->ToObject();
+		Local<Array> keys = methods->GetOwnPropertyNames();
+		for (uint32_t i = 0; i < keys->Length(); i++) {
+			Local<Value> key = keys->Get(i), value = methods->Get(key);
+			String::Value vkey(key);
+			member_t &member = server->AddMember((LPOLESTR)*vkey);
+			member.method = true;
+			member.echo = value->IsUndefined() || value->IsNull();
+			if (!member.echo) Value2Variant(isolate, value, member.value);
+		}
+	}
+
+	// Methods adding properties later: { name: true }, srv.Define('Name', value)
+	val = spec->Get(String::NewFromUtf8(isolate, "expando"));
+	if (!val.IsEmpty() && val->IsObject()) {
+		Local<Array> keys = val->ToObject()->GetOwnPropertyNames();
+		for (uint32_t i = 0; i < keys->Length(); i++) {
+			String::Value vkey(keys->Get(i));
+			member_t &member = server->AddMember((LPOLESTR)*vkey);
+			member.method = true;
+			member.define = true;
+		}
+	}
+
+	// Value types of members: { name: VARTYPE }, for example VT_ARRAY | VT_DATE (0x2007)
+	val = spec->Get(String::NewFromUtf8(isolate, "types"));
+	if (!val.IsEmpty() && val->IsObject()) {
+		Local<Object> types = val->ToObject();
+		Local<Array> keys = types->GetOwnPropertyNames();
+		for (uint32_t i = 0; i < keys->Length(); i++) {
+			Local<Value> key = keys->Get(i);
+			String::Value vkey(key);
+			member_t &member = server->AddMember((LPOLESTR)*vkey);
+			HRESULT hrcode = ChangeType(member.value, (VARTYPE)types->Get(key)->Uint32Value());
+			if FAILED(hrcode) {
+				isolate->ThrowException(Win32Error(isolate, hrcode, L"VariantChangeType"));
+				return;
+			}
+		}
+	}
+
+	// Failing members: { name: HRESULT }
+	val = spec->Get(String::NewFromUtf8(isolate, "errors"));
+	if (!val.IsEmpty() && val->IsObject()) {
+		Local<Object> errors = val->ToObject();
+		Local<Array> keys = errors->GetOwnPropertyNames();
+		for (uint32_t i = 0; i < keys->Length(); i++) {
+			Local<Value> key = keys->Get(i);
+			String::Value vkey(key);
+			member_t &member = server->AddMember((LPOLESTR)*vkey);
+			member.error = (HRESULT)errors->Get(key)->Int32Value();
+		}
+	}
+
+	val = spec->Get(String::NewFromUtf8(isolate, "items"));
+	if (!val.IsEmpty() && val->IsArray()) {
+		Local<Array> items = Local<Array>::Cast(val);
+		server->items.resize(items->Length());
+		for (uint32_t i = 0; i < items->Length(); i++) {
+			Local<Value> item = items->Get(i);
+			Value2Variant(isolate, item, server->items[i]);
+		}
+	}
+
+	val = spec->Get(String::NewFromUtf8(isolate, "latency"));
+	if (!val.IsEmpty() && val->IsUint32()) server->latency = val->Uint32Value();
+
+	// Type info with interface GUID: { typeInfo: '{00000000-0000-0000-0000-000000000000}' }
+	val = spec->Get(String::NewFromUtf8(isolate, "typeInfo"));
+	GUID guid = GUID_NULL;
+	HRESULT hrcode = S_OK;
+	if (!val.IsEmpty() && val->IsString()) {
+		String::Value vguid(val);
+		hrcode = IIDFromString((LPOLESTR)*vguid, &guid);
+	}
+	if (SUCCEEDED(hrcode) && (guid != GUID_NULL || v8val2bool(val, false))) hrcode = server->BuildTypeInfo(guid);
+	if FAILED(hrcode) {
+		isolate->ThrowException(Win32Error(isolate, hrcode, L"CreateDispTypeInfo"));
+		return;
+	}
+	int options = option_auto;
+	if (v8val2bool(spec->Get(String::NewFromUtf8(isolate, "eager")), false)) options |= option_eager;
+	args.GetReturnValue().Set(DispObject::NodeCreate(isolate, server, L"TestServer", options));
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispTestEnum implemetation
+
+HRESULT STDMETHODCALLTYPE DispTestEnum::Next(ULONG celt, VARIANT *rgVar, ULONG *pCeltFetched) {
+	ULONG fetched = 0;
+	HRESULT hrcode = S_OK;
+	while (fetched < celt && pos < items.size() && SUCCEEDED(hrcode)) {
+		VariantInit(&rgVar[fetched]);
+		hrcode = VariantCopy(&rgVar[fetched++], &items[pos++]);
+	}
+	if (pCeltFetched) *pCeltFetched = fetched;
+	if FAILED(hrcode) return hrcode;
+	return (fetched == celt) ? S_OK : S_FALSE;
+}
+
+HRESULT STDMETHODCALLTYPE DispTestEnum::Skip(ULONG celt) {
+	pos += celt;
+	if (pos <= items.size()) return S_OK;
+	pos = items.size();
+	return S_FALSE;
+}
+
+HRESULT STDMETHODCALLTYPE DispTestEnum::Clone(IEnumVARIANT **ppEnum) {
+	if (!ppEnum) return E_POINTER;
+	DispTestEnum *enm = new DispTestEnum(items);
+	enm->pos = pos;
+	*ppEnum = enm;
+	enm->AddRef();
+	return S_OK;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// DispTestTypeInfo implemetation
+
+// Attributes are a copy owned by caller until ReleaseTypeAttr, so GUID is replaced in place
+HRESULT STDMETHODCALLTYPE DispTestTypeInfo::GetTypeAttr(TYPEATTR **ppTypeAttr) {
+	HRESULT hrcode = inner->GetTypeAttr(ppTypeAttr);
+	if SUCCEEDED(hrcode) (*ppTypeAttr)->guid = guid;
+	return hrcode;
+}
+
+//-------------------------------------------------------------------------------------------------------
@@ -0,0 +1,105 @@
+//-------------------------------------------------------------------------------------------------------
+// Project: NodeActiveX
+// Author: Yuri Dursin
+// Description: DispTestServer class declarations. In-process dispatch server for tests and benchmarks
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "disp.h"
+
+//-------------------------------------------------------------------------------------------------------
+// Members are configured from JS, so marshaling and dispatch costs are measured without Office or ADO
+
+class DispTestServer : public UnknownImpl<IDispatch> {
+public:
+	struct member_t {
+		std::wstring name;
+		bool method;
+		bool echo;			// method returns its first argument
+		bool define;		// method adds property (name, value) as VBA or WMI objects gain members
+		CComVariant value;	// property value or method result
+		HRESULT error;		// returned by every call when failed
+		inline member_t() : method(false), echo(false), define(false), error(S_OK) {}
+	};
+
+	std::vector<member_t> members;	// DISPID is index + 1
+	std::vector<CComVariant> items;	// indexed by DISPID_VALUE and enumerated by _NewEnum
+	ULONG latency;					// microseconds spent in each call
+	CComPtr<ITypeInfo> type_info;
+
+	// Name lookups of all test servers and their type information (winax.stats().testServer.lookups)
+	static ULONGLONG lookups;
+
+	inline DispTestServer() : latency(0) {}
+	HRESULT BuildTypeInfo(const GUID &guid = GUID_NULL);
+
+	// winax.testServer({ properties, methods, types, expando, errors, items, latency, typeInfo: true or interface GUID, eager })
+	static void NodeCreate(const FunctionCallbackInfo<Value> &args);
+
+	// IDispatch interface
+	virtual HRESULT STDMETHODCALLTYPE GetTypeInfoCount(UINT *pctinfo) { *pctinfo = type_info ? 1 : 0; return S_OK; }
+	virtual HRESULT STDMETHODCALLTYPE GetTypeInfo(UINT iTInfo, LCID lcid, ITypeInfo **ppTInfo);
+	virtual HRESULT STDMETHODCALLTYPE GetIDsOfNames(REFIID riid, LPOLESTR *rgszNames, UINT cNames, LCID lcid, DISPID *rgDispId);
+	virtual HRESULT STDMETHODCALLTYPE Invoke(DISPID dispIdMember, REFIID riid, LCID lcid, WORD wFlags, DISPPARAMS *pDispParams, VARIANT *pVarResult, EXCEPINFO *pExcepInfo, UINT *puArgErr);
+
+private:
+	FlatMap<std::wstring, DISPID, FlatHashNoCase, FlatEqualNoCase> names;
+	member_t &AddMember(const std::wstring &name);
+	static HRESULT ChangeType(VARIANT &value, VARTYPE vt);
+	void Wait();
+};
+
+//-------------------------------------------------------------------------------------------------------
+
+class DispTestEnum : public UnknownImpl<IEnumVARIANT> {
+public:
+	inline DispTestEnum(const std::vector<CComVariant> &itms) : items(itms), pos(0) {}
+
+	// IEnumVARIANT interface
+	virtual HRESULT STDMETHODCALLTYPE Next(ULONG celt, VARIANT *rgVar, ULONG *pCeltFetched);
+	virtual HRESULT STDMETHODCALLTYPE Skip(ULONG celt);
+	virtual HRESULT STDMETHODCALLTYPE Reset() { pos = 0; return S_OK; }
+	virtual HRESULT STDMETHODCALLTYPE Clone(IEnumVARIANT **ppEnum);
+
+private:
+	std::vector<CComVariant> items;
+	size_t pos;
+};
+
+//-------------------------------------------------------------------------------------------------------
+
+// Type information created by CreateDispTypeInfo has no GUID, wrapper reports configured one,
+// so descriptions and templates are shared as for interfaces of real servers
+
+class DispTestTypeInfo : public UnknownImpl<ITypeInfo> {
+public:
+	inline DispTestTypeInfo(ITypeInfo *info, const GUID &iid) : inner(info), guid(iid) {}
+
+	// ITypeInfo interface
+	virtual HRESULT STDMETHODCALLTYPE GetTypeAttr(TYPEATTR **ppTypeAttr);
+	virtual HRESULT STDMETHODCALLTYPE GetTypeComp(ITypeComp **ppTComp) { return inner->GetTypeComp(ppTComp); }
+	virtual HRESULT STDMETHODCALLTYPE GetFuncDesc(UINT index, FUNCDESC **ppFuncDesc) { return inner->GetFuncDesc(index, ppFuncDesc); }
+	virtual HRESULT STDMETHODCALLTYPE GetVarDesc(UINT index, VARDESC **ppVarDesc) { return inner->GetVarDesc(index, ppVarDesc); }
+	virtual HRESULT STDMETHODCALLTYPE GetNames(MEMBERID memid, BSTR *rgBstrNames, UINT cMaxNames, UINT *pcNames) { return inner->GetNames(memid, rgBstrNames, cMaxNames, pcNames); }
+	virtual HRESULT STDMETHODCALLTYPE GetRefTypeOfImplType(UINT index, HREFTYPE *pRefType) { return inner->GetRefTypeOfImplType(index, pRefType); }
+	virtual HRESULT STDMETHODCALLTYPE GetImplTypeFlags(UINT index, INT *pImplTypeFlags) { return inner->GetImplTypeFlags(index, pImplTypeFlags); }
+	virtual HRESULT STDMETHODCALLTYPE GetIDsOfNames(LPOLESTR *rgszNames, UINT cNames, MEMBERID *pMemId) { DispTestServer::lookups++; return inner->GetIDsOfNames(rgszNames, cNames, pMemId); }
+	virtual HRESULT STDMETHODCALLTYPE Invoke(PVOID pvInstance, MEMBERID memid, WORD wFlags, DISPPARAMS *pDispParams, VARIANT *pVarResult, EXCEPINFO *pExcepInfo, UINT *puArgErr) { return inner->Invoke(pvInstance, memid, wFlags, pDispParams, pVarResult, pExcepInfo, puArgErr); }
+	virtual HRESULT STDMETHODCALLTYPE GetDocumentation(MEMBERID memid, BSTR *pBstrName, BSTR *pBstrDocString, DWORD *pdwHelpContext, BSTR *pBstrHelpFile) { return inner->GetDocumentation(memid, pBstrName, pBstrDocString, pdwHelpContext, pBstrHelpFile); }
+	virtual HRESULT STDMETHODCALLTYPE GetDllEntry(MEMBERID memid, INVOKEKIND invKind, BSTR *pBstrDllName, BSTR *pBstrName, WORD *pwOrdinal) { return inner->GetDllEntry(memid, invKind, pBstrDllName, pBstrName, pwOrdinal); }
+	virtual HRESULT STDMETHODCALLTYPE GetRefTypeInfo(HREFTYPE hRefType, ITypeInfo **ppTInfo) { return inner->GetRefTypeInfo(hRefType, ppTInfo); }
+	virtual HRESULT STDMETHODCALLTYPE AddressOfMember(MEMBERID memid, INVOKEKIND invKind, PVOID *ppv) { return inner->AddressOfMember(memid, invKind, ppv); }
+	virtual HRESULT STDMETHODCALLTYPE CreateInstance(IUnknown *pUnkOuter, REFIID riid, PVOID *ppvObj) { return inner->CreateInstance(pUnkOuter, riid, ppvObj); }
+	virtual HRESULT STDMETHODCALLTYPE GetMops(MEMBERID memid, BSTR *pBstrMops) { return inner->GetMops(memid, pBstrMops); }
+	virtual HRESULT STDMETHODCALLTYPE GetContainingTypeLib(ITypeLib **ppTLib, UINT *pIndex) { return inner->GetContainingTypeLib(ppTLib, pIndex); }
+	virtual void STDMETHODCALLTYPE ReleaseTypeAttr(TYPEATTR *pTypeAttr) { inner->ReleaseTypeAttr(pTypeAttr); }
+	virtual void STDMETHODCALLTYPE ReleaseFuncDesc(FUNCDESC *pFuncDesc) { inner->ReleaseFuncDesc(pFuncDesc); }
+	virtual void STDMETHODCALLTYPE ReleaseVarDesc(VARDESC *pVarDesc) { inner->ReleaseVarDesc(pVarDesc); }
+
+private:
+	CComPtr<ITypeInfo> inner;
+	GUID guid;
+};
+
+//-------------------------------------------------------------------------------------------------------
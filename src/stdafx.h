@@ -19,9 +19,12 @@
 // STD headers
 #include <iostream>
 #include <stdio.h>
+#include <math.h>
+#include <limits.h>
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
 #include <memory>
 
 // Node JS headers
@@ -30,5 +33,6 @@
 #include <node_version.h>
 #include <node_object_wrap.h>
 #include <node_buffer.h>
+#include <uv.h>
 using namespace v8;
 using namespace node;
\ No newline at end of file
@@ -58,46 +58,501 @@ Local<String> GetWin32ErroroMessage(Isolate *isolate, HRESULT hrcode, LPCOLESTR
 
 //-------------------------------------------------------------------------------------------------------
 
+// Element kernels read array items directly from locked SAFEARRAY data
+typedef Local<Value> (*array_item_t)(Isolate *isolate, const void *ptr);
+
+template<typename T, typename V>
+static Local<Value> ArrayItemInt(Isolate *isolate, const void *ptr) {
+	return V::New(isolate, *(const T*)ptr);
+}
+
+template<typename T>
+static Local<Value> ArrayItemNumber(Isolate *isolate, const void *ptr) {
+	return Number::New(isolate, (double)*(const T*)ptr);
+}
+
+static Local<Value> ArrayItemBool(Isolate *isolate, const void *ptr) {
+	return Boolean::New(isolate, *(const VARIANT_BOOL*)ptr != VARIANT_FALSE);
+}
+
+static Local<Value> ArrayItemVariant(Isolate *isolate, const void *ptr) {
+	return Variant2Value(isolate, *(const VARIANT*)ptr, true);
+}
+
+template<VARTYPE VT>
+static Local<Value> ArrayItemRef(Isolate *isolate, const void *ptr) {
+	VARIANT v;
+	v.vt = VT | VT_BYREF;
+	v.byref = (PVOID)ptr;
+	return Variant2Value(isolate, v, true);
+}
+
+static array_item_t ArrayItemKernel(VARTYPE vt) {
+	switch (vt) {
+	case VT_I1: return ArrayItemInt<CHAR, Int32>;
+	case VT_I2: return ArrayItemInt<SHORT, Int32>;
+	case VT_I4: return ArrayItemInt<LONG, Int32>;
+	case VT_INT: return ArrayItemInt<INT, Int32>;
+	case VT_UI1: return ArrayItemInt<BYTE, Uint32>;
+	case VT_UI2: return ArrayItemInt<USHORT, Uint32>;
+	case VT_UI4: return ArrayItemInt<ULONG, Uint32>;
+	case VT_UINT: return ArrayItemInt<UINT, Uint32>;
+	case VT_R4: return ArrayItemNumber<FLOAT>;
+	case VT_R8: return ArrayItemNumber<DOUBLE>;
+	case VT_BOOL: return ArrayItemBool;
+	case VT_VARIANT: return ArrayItemVariant;
+	case VT_BSTR: return ArrayItemRef<VT_BSTR>;
+	case VT_DATE: return ArrayItemRef<VT_DATE>;
+	case VT_I8: return ArrayItemRef<VT_I8>;
+	case VT_UI8: return ArrayItemRef<VT_UI8>;
+	case VT_CY: return ArrayItemRef<VT_CY>;
+	case VT_DECIMAL: return ArrayItemRef<VT_DECIMAL>;
+	case VT_DISPATCH: return ArrayItemRef<VT_DISPATCH>;
+	case VT_UNKNOWN: return ArrayItemRef<VT_UNKNOWN>;
+	}
+	return nullptr;
+}
+
+// Nested arrays: the first (left-most) index is the outer array, JS index 0 is the lower bound
+static Local<Value> ArrayDimension(Isolate *isolate, array_item_t item, const SAFEARRAY *varr, UINT dim, const size_t *strides, const BYTE *data) {
+	const SAFEARRAYBOUND &bound = varr->rgsabound[varr->cDims - dim - 1];
+	uint32_t cnt = (uint32_t)bound.cElements;
+	Local<Array> arr = Array::New(isolate, cnt);
+	bool last = (dim + 1 == varr->cDims);
+	for (uint32_t i = 0; i < cnt; i++) {
+		const BYTE *ptr = data + i * strides[dim];
+		arr->Set(i, last ? item(isolate, ptr) : ArrayDimension(isolate, item, varr, dim + 1, strides, ptr));
+	}
+	return arr;
+}
+
 Local<Value> Variant2Array(Isolate *isolate, const VARIANT &v) {
 	if ((v.vt & VT_ARRAY) == 0) return Null(isolate);
 	SAFEARRAY *varr = (v.vt & VT_BYREF) != 0 ? *v.pparray : v.parray;
-	if (!varr || varr->cDims != 1) return Null(isolate);
-	LONG cnt = (LONG)varr->rgsabound[0].cElements;
-	Local<Array> arr = Array::New(isolate, cnt);
-	for (LONG i = 0; i < cnt; i++) {
-		CComVariant var;
-		if SUCCEEDED(SafeArrayGetElement(varr, &i, (VARIANT*)&var)) {
-			arr->Set((uint32_t)i, Variant2Value(isolate, v, true));
-		}
+	if (!varr || varr->cDims == 0) return Null(isolate);
+	array_item_t item = ArrayItemKernel(v.vt & VT_TYPEMASK);
+	if (!item) return Null(isolate);
+
+	// Left-most index changes fastest in memory
+	std::vector<size_t> strides(varr->cDims);
+	size_t stride = varr->cbElements;
+	for (UINT dim = 0; dim < varr->cDims; dim++) {
+		strides[dim] = stride;
+		stride *= varr->rgsabound[varr->cDims - dim - 1].cElements;
 	}
-	return arr;
+
+	BYTE *data;
+	if FAILED(SafeArrayAccessData(varr, (void**)&data)) return Null(isolate);
+	Local<Value> result = ArrayDimension(isolate, item, varr, 0, &strides[0], data);
+	SafeArrayUnaccessData(varr);
+	return result;
 }
 
-Local<Value> Variant2Value(Isolate *isolate, const VARIANT &v, bool allow_disp) {
-	if ((v.vt & VT_ARRAY) != 0) return Variant2Array(isolate, v);
+static void TypedArrayFree(char *data, void *hint) {
+	SAFEARRAY *varr = (SAFEARRAY*)hint;
+	SafeArrayUnaccessData(varr);
+	SafeArrayDestroy(varr);
+}
+
+bool Variant2TypedArray(Isolate *isolate, VARIANT &v, bool move, Local<Value> &result) {
+	if ((v.vt & VT_ARRAY) == 0) return false;
 	VARTYPE vt = (v.vt & VT_TYPEMASK);
 	bool by_ref = (v.vt & VT_BYREF) != 0;
 	switch (vt) {
+	case VT_I1: case VT_UI1: case VT_I2: case VT_UI2:
+	case VT_I4: case VT_UI4: case VT_INT: case VT_UINT:
+	case VT_R4: case VT_R8:
+		break;
+	default:
+		return false;
+	}
+	SAFEARRAY *varr = by_ref ? *v.pparray : v.parray;
+	if (!varr || varr->cDims != 1) return false;
+	size_t cnt = varr->rgsabound[0].cElements, len = cnt * varr->cbElements;
+	char *data;
+	if FAILED(SafeArrayAccessData(varr, (void**)&data)) return false;
+
+	// Owned array data is moved to node buffer without copy, it is destroyed by garbage collector
+	Local<Object> buf;
+	if (move && !by_ref && (varr->fFeatures & (FADF_AUTO | FADF_STATIC | FADF_EMBEDDED)) == 0) {
+		if (!Buffer::New(isolate, data, len, TypedArrayFree, varr).ToLocal(&buf)) {
+			SafeArrayUnaccessData(varr);
+			return false;
+		}
+		v.vt = VT_EMPTY;
+	}
+	else {
+		bool copied = Buffer::Copy(isolate, data, len).ToLocal(&buf);
+		SafeArrayUnaccessData(varr);
+		if (!copied) return false;
+	}
+	if (vt == VT_UI1) {
+		result = buf;
+		return true;
+	}
+
+	Local<ArrayBuffer> abuf = buf.As<Uint8Array>()->Buffer();
+	size_t offset = buf.As<Uint8Array>()->ByteOffset();
+	switch (vt) {
+	case VT_I1: result = Int8Array::New(abuf, offset, cnt); break;
+	case VT_I2: result = Int16Array::New(abuf, offset, cnt); break;
+	case VT_UI2: result = Uint16Array::New(abuf, offset, cnt); break;
+	case VT_I4: case VT_INT: result = Int32Array::New(abuf, offset, cnt); break;
+	case VT_UI4: case VT_UINT: result = Uint32Array::New(abuf, offset, cnt); break;
+	case VT_R4: result = Float32Array::New(abuf, offset, cnt); break;
+	case VT_R8: result = Float64Array::New(abuf, offset, cnt); break;
+	}
+	return true;
+}
+
+bool TypedArray2Variant(Isolate *isolate, const Local<Value> &val, VARIANT &var) {
+	VARTYPE vt;
+	size_t size;
+	if (val->IsFloat64Array()) { vt = VT_R8; size = sizeof(DOUBLE); }
+	else if (val->IsFloat32Array()) { vt = VT_R4; size = sizeof(FLOAT); }
+	else if (val->IsInt32Array()) { vt = VT_I4; size = sizeof(LONG); }
+	else if (val->IsUint32Array()) { vt = VT_UI4; size = sizeof(ULONG); }
+	else if (val->IsInt16Array()) { vt = VT_I2; size = sizeof(SHORT); }
+	else if (val->IsUint16Array()) { vt = VT_UI2; size = sizeof(USHORT); }
+	else if (val->IsInt8Array()) { vt = VT_I1; size = sizeof(CHAR); }
+	else if (val->IsUint8Array() || val->IsUint8ClampedArray() || val->IsArrayBuffer()) { vt = VT_UI1; size = sizeof(BYTE); }
+	else return false;
+
+	// Homogeneous array, one copy of the whole block
+	const char *data;
+	size_t len;
+	if (val->IsArrayBuffer()) {
+		Local<ArrayBuffer> abuf = val.As<ArrayBuffer>();
+		data = (const char*)abuf->GetContents().Data();
+		len = abuf->ByteLength();
+	}
+	else {
+		Local<ArrayBufferView> view = val.As<ArrayBufferView>();
+		data = (const char*)view->Buffer()->GetContents().Data() + view->ByteOffset();
+		len = view->ByteLength();
+	}
+	CComArray arr;
+	if FAILED(arr.Prepare(vt, (ULONG)(len / size))) return false;
+	if (len > 0) memcpy(arr.GetElement<char>(), data, len);
+	arr.Detach(&var);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// Strings are copied once in both directions, short ones are internalized to share repeated names
+
+const int bstr_short_length = 32;
+const int bstr_external_length = 4096;
+
+class BstrResource: public String::ExternalStringResource {
+public:
+	inline BstrResource(BSTR b) : bstr(b) {}
+	~BstrResource() { if (bstr) SysFreeString(bstr); }
+	virtual const uint16_t *data() const { return (const uint16_t*)bstr; }
+	virtual size_t length() const { return SysStringLen(bstr); }
+	inline void Detach() { bstr = nullptr; }
+private:
+	BSTR bstr;
+};
+
+Local<String> Bstr2String(Isolate *isolate, BSTR bstr, bool internalize) {
+	int len = bstr ? (int)SysStringLen(bstr) : 0;
+	if (len == 0) return String::Empty(isolate);
+	String::NewStringType type = (internalize || len <= bstr_short_length) ? String::kInternalizedString : String::kNormalString;
+	return String::NewFromTwoByte(isolate, (uint16_t*)bstr, type, len);
+}
+
+// Long owned strings are not copied, V8 frees them with the string
+Local<String> Bstr2StringMove(Isolate *isolate, BSTR &bstr) {
+	int len = bstr ? (int)SysStringLen(bstr) : 0;
+	if (len < bstr_external_length) return Bstr2String(isolate, bstr);
+	BstrResource *res = new BstrResource(bstr);
+	Local<String> str;
+	if (!String::NewExternalTwoByte(isolate, res).ToLocal(&str)) {
+		res->Detach();
+		delete res;
+		return Bstr2String(isolate, bstr);
+	}
+	bstr = nullptr;
+	return str;
+}
+
+BSTR Value2Bstr(const Local<Value> &val) {
+	Local<String> str = val->ToString();
+	int len = str.IsEmpty() ? 0 : str->Length();
+	if (len == 0) return 0;
+	BSTR bstr = SysAllocStringLen(0, len);
+	if (bstr) str->Write((uint16_t*)bstr, 0, len, String::NO_NULL_TERMINATION);
+	return bstr;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// Date conversions
+
+bool var_date_utc = false;
+
+static const double date_epoch_days = 25569;	// 1970-01-01 as OLE date
+static const double date_day_ms = 86400000;
+
+// Local time offset at UTC time, conversions of date columns mostly hit the same quarter of hour
+static double LocalOffset(double time) {
+	static LONGLONG cached_slot = LLONG_MIN;
+	static double cached_offset = 0;
+	if (!_finite(time)) return 0;
+	LONGLONG slot = (LONGLONG)floor(time / 900000);
+	if (slot == cached_slot) return cached_offset;
+
+	// FILETIME counts 100ns intervals since 1601-01-01, earlier dates use standard bias
+	LONGLONG ticks = (slot * 900000 + 11644473600000LL) * 10000;
+	ULARGE_INTEGER utc, local;
+	FILETIME ft, lft;
+	SYSTEMTIME st, lst;
+	utc.QuadPart = (ULONGLONG)ticks;
+	ft.dwLowDateTime = utc.LowPart;
+	ft.dwHighDateTime = utc.HighPart;
+	if (ticks >= 0 && FileTimeToSystemTime(&ft, &st) && SystemTimeToTzSpecificLocalTime(NULL, &st, &lst) && SystemTimeToFileTime(&lst, &lft)) {
+		local.LowPart = lft.dwLowDateTime;
+		local.HighPart = lft.dwHighDateTime;
+		cached_offset = (double)(((LONGLONG)local.QuadPart - ticks) / 10000);
+	}
+	else {
+		TIME_ZONE_INFORMATION tzi;
+		GetTimeZoneInformation(&tzi);
+		cached_offset = -(double)tzi.Bias * 60000;
+	}
+	cached_slot = slot;
+	return cached_offset;
+}
+
+// Negative OLE dates count days backward but the fraction (time of day) forward: -1.25 is 1899-12-29 06:00
+double OleDate2Time(DATE date) {
+	double whole = (double)(LONGLONG)date;
+	double time = floor((whole + fabs(date - whole) - date_epoch_days) * date_day_ms + 0.5);
+	if (var_date_utc) return time;
+
+	// Local wall time to UTC, second pass takes offset at the result for times near transitions
+	return time - LocalOffset(time - LocalOffset(time));
+}
+
+DATE Time2OleDate(double time) {
+	if (!var_date_utc) time += LocalOffset(time);
+	double days = time / date_day_ms + date_epoch_days;
+	double whole = floor(days);
+	return (days < 0) ? whole - (days - whole) : days;
+}
+
+//-------------------------------------------------------------------------------------------------------
+// Scalar VARIANT conversion tables
+
+#ifdef HAS_BIGINT
+bool var_bigint = true;
+#else
+bool var_bigint = false;
+#endif
+bool var_decimal_string = false;
+
+// 64-bit integers are exact as BigInt only, numbers are used for older V8 or when configured
+struct VarInt64 {
+	static inline Local<Value> New(Isolate *isolate, LONGLONG x) {
+#ifdef HAS_BIGINT
+		if (var_bigint) return BigInt::New(isolate, x);
+#endif
+		return Number::New(isolate, (double)x);
+	}
+};
+
+struct VarUint64 {
+	static inline Local<Value> New(Isolate *isolate, ULONGLONG x) {
+#ifdef HAS_BIGINT
+		if (var_bigint) return BigInt::NewFromUnsigned(isolate, x);
+#endif
+		return Number::New(isolate, (double)x);
+	}
+};
+
+struct VarDate {
+	static inline Local<Value> New(Isolate *isolate, DATE x) { return Date::New(isolate, OleDate2Time(x)); }
+};
+
+// Exact text of unsigned 96-bit mantissa divided by 10^scale, fraction trailing zeros are dropped
+static Local<Value> DecimalString(Isolate *isolate, bool neg, ULONG hi, ULONGLONG lo, int scale) {
+	ULONG parts[3] = { hi, (ULONG)(lo >> 32), (ULONG)lo };
+	char digits[32];
+	int cnt = 0;
+	do {
+		ULONGLONG rem = 0;
+		for (int i = 0; i < 3; i++) {
+			ULONGLONG cur = (rem << 32) | parts[i];
+			parts[i] = (ULONG)(cur / 10);
+			rem = cur % 10;
+		}
+		digits[cnt++] = (char)('0' + rem);
+	} while (parts[0] || parts[1] || parts[2]);
+
+	int skip = 0;
+	while (skip < scale && (skip >= cnt || digits[skip] == '0')) skip++;
+	char buf[64], *ptr = buf;
+	if (neg && (cnt > 1 || digits[0] != '0')) *ptr++ = '-';
+	if (cnt <= scale) *ptr++ = '0';
+	for (int i = cnt - 1; i >= scale; i--) *ptr++ = digits[i];
+	if (skip < scale) {
+		*ptr++ = '.';
+		for (int i = scale - 1; i >= skip; i--) *ptr++ = (i < cnt) ? digits[i] : '0';
+	}
+	*ptr = 0;
+	return String::NewFromUtf8(isolate, buf, String::kNormalString, (int)(ptr - buf));
+}
+
+// Field access and conversions, specialized per VARTYPE so that every read has the type width
+template<VARTYPE VT> struct VarScalar;
+
+template<typename T, typename JS>
+struct VarScalarBase {
+	typedef T type;
+	static inline LONGLONG integer(T x) { return (LONGLONG)x; }
+	static inline double number(T x) { return (double)x; }
+	static inline Local<Value> value(Isolate *isolate, T x) { return JS::New(isolate, x); }
+};
+
+#define VAR_SCALAR(vt, T, JS, field, ref_field) \
+	template<> struct VarScalar<vt> : public VarScalarBase<T, JS> { \
+		static inline T get(const VARIANT &v) { return v.field; } \
+		static inline T get_ref(const VARIANT &v) { return *v.ref_field; } \
+	};
+
+VAR_SCALAR(VT_I1, CHAR, Int32, cVal, pcVal)
+VAR_SCALAR(VT_I2, SHORT, Int32, iVal, piVal)
+VAR_SCALAR(VT_I4, LONG, Int32, lVal, plVal)
+VAR_SCALAR(VT_INT, INT, Int32, intVal, pintVal)
+VAR_SCALAR(VT_UI1, BYTE, Uint32, bVal, pbVal)
+VAR_SCALAR(VT_UI2, USHORT, Uint32, uiVal, puiVal)
+VAR_SCALAR(VT_UI4, ULONG, Uint32, ulVal, pulVal)
+VAR_SCALAR(VT_UINT, UINT, Uint32, uintVal, puintVal)
+VAR_SCALAR(VT_I8, LONGLONG, VarInt64, llVal, pllVal)
+VAR_SCALAR(VT_UI8, ULONGLONG, VarUint64, ullVal, pullVal)
+VAR_SCALAR(VT_R4, FLOAT, Number, fltVal, pfltVal)
+VAR_SCALAR(VT_R8, DOUBLE, Number, dblVal, pdblVal)
+VAR_SCALAR(VT_DATE, DATE, VarDate, date, pdate)
+
+template<> struct VarScalar<VT_BOOL> {
+	typedef VARIANT_BOOL type;
+	static inline type get(const VARIANT &v) { return v.boolVal; }
+	static inline type get_ref(const VARIANT &v) { return *v.pboolVal; }
+	static inline LONGLONG integer(type x) { return (x != VARIANT_FALSE) ? 1 : 0; }
+	static inline double number(type x) { return (x != VARIANT_FALSE) ? 1 : 0; }
+	static inline Local<Value> value(Isolate *isolate, type x) { return Boolean::New(isolate, x != VARIANT_FALSE); }
+};
+
+// Currency is a fixed point number scaled by 10000
+template<> struct VarScalar<VT_CY> {
+	typedef CY type;
+	static inline type get(const VARIANT &v) { return v.cyVal; }
+	static inline type get_ref(const VARIANT &v) { return *v.pcyVal; }
+	static inline LONGLONG integer(const type &x) { return x.int64 / 10000; }
+	static inline double number(const type &x) { return (double)x.int64 / 10000; }
+	static inline Local<Value> value(Isolate *isolate, const type &x) {
+		if (!var_decimal_string) return Number::New(isolate, number(x));
+		ULONGLONG mag = (x.int64 < 0) ? (ULONGLONG)(-(x.int64 + 1)) + 1 : (ULONGLONG)x.int64;
+		return DecimalString(isolate, x.int64 < 0, 0, mag, 4);
+	}
+};
+
+// Decimal is a 96-bit integer with sign and power of ten scale
+static const double decimal_scales[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28 };
+
+template<> struct VarScalar<VT_DECIMAL> {
+	typedef DECIMAL type;
+	static inline type get(const VARIANT &v) { return v.decVal; }
+	static inline type get_ref(const VARIANT &v) { return *v.pdecVal; }
+	static inline double number(const type &x) {
+		double val = (double)x.Hi32 * 18446744073709551616.0 + (double)x.Lo64;
+		if (x.scale > 0 && x.scale < 29) val /= decimal_scales[x.scale];
+		return (x.sign & DECIMAL_NEG) ? -val : val;
+	}
+	static inline LONGLONG integer(const type &x) { return (LONGLONG)number(x); }
+	static inline Local<Value> value(Isolate *isolate, const type &x) {
+		if (!var_decimal_string) return Number::New(isolate, number(x));
+		return DecimalString(isolate, (x.sign & DECIMAL_NEG) != 0, x.Hi32, x.Lo64, x.scale);
+	}
+};
+
+#undef VAR_SCALAR
+
+template<VARTYPE VT, bool BYREF>
+static inline typename VarScalar<VT>::type VarScalarRead(const VARIANT &v) {
+	return BYREF ? VarScalar<VT>::get_ref(v) : VarScalar<VT>::get(v);
+}
+
+template<VARTYPE VT, bool BYREF>
+static LONGLONG VarScalarInt(const VARIANT &v) {
+	return VarScalar<VT>::integer(VarScalarRead<VT, BYREF>(v));
+}
+
+template<VARTYPE VT, bool BYREF>
+static double VarScalarDouble(const VARIANT &v) {
+	return VarScalar<VT>::number(VarScalarRead<VT, BYREF>(v));
+}
+
+template<VARTYPE VT, bool BYREF>
+static Local<Value> VarScalarValue(Isolate *isolate, const VARIANT &v) {
+	return VarScalar<VT>::value(isolate, VarScalarRead<VT, BYREF>(v));
+}
+
+#define VAR_CONV(vt, kind, byref) { VarConv::kind, VarScalarInt<vt, byref>, VarScalarDouble<vt, byref>, VarScalarValue<vt, byref> }
+#define VAR_CONV_NONE { VarConv::kind_none, nullptr, nullptr, nullptr }
+#define VAR_CONV_ROW(byref) { \
+	VAR_CONV_NONE, /* VT_EMPTY */ \
+	VAR_CONV_NONE, /* VT_NULL */ \
+	VAR_CONV(VT_I2, kind_int, byref), \
+	VAR_CONV(VT_I4, kind_int, byref), \
+	VAR_CONV(VT_R4, kind_real, byref), \
+	VAR_CONV(VT_R8, kind_real, byref), \
+	VAR_CONV(VT_CY, kind_other, byref), \
+	VAR_CONV(VT_DATE, kind_other, byref), \
+	VAR_CONV_NONE, /* VT_BSTR */ \
+	VAR_CONV_NONE, /* VT_DISPATCH */ \
+	VAR_CONV_NONE, /* VT_ERROR */ \
+	VAR_CONV(VT_BOOL, kind_other, byref), \
+	VAR_CONV_NONE, /* VT_VARIANT */ \
+	VAR_CONV_NONE, /* VT_UNKNOWN */ \
+	VAR_CONV(VT_DECIMAL, kind_other, byref), \
+	VAR_CONV_NONE, /* 15 is not used */ \
+	VAR_CONV(VT_I1, kind_int, byref), \
+	VAR_CONV(VT_UI1, kind_int, byref), \
+	VAR_CONV(VT_UI2, kind_int, byref), \
+	VAR_CONV(VT_UI4, kind_int, byref), \
+	VAR_CONV(VT_I8, kind_int64, byref), \
+	VAR_CONV(VT_UI8, kind_int64, byref), \
+	VAR_CONV(VT_INT, kind_int, byref), \
+	VAR_CONV(VT_UINT, kind_int, byref) \
+}
+
+const VarConv var_conv[2][VT_UINT + 1] = { VAR_CONV_ROW(false), VAR_CONV_ROW(true) };
+
+#undef VAR_CONV_ROW
+#undef VAR_CONV_NONE
+#undef VAR_CONV
+
+//-------------------------------------------------------------------------------------------------------
+
+Local<Value> Variant2Result(Isolate *isolate, VARIANT &v, int opt) {
+	Local<Value> result;
+	if (v.vt == VT_BSTR) return Bstr2StringMove(isolate, v.bstrVal);
+	if ((opt & option_typed) != 0 && Variant2TypedArray(isolate, v, true, result)) return result;
+	return Variant2Value(isolate, v, false, opt);
+}
+
+Local<Value> Variant2Value(Isolate *isolate, const VARIANT &v, bool allow_disp, int opt) {
+	if ((v.vt & VT_ARRAY) != 0) {
+		Local<Value> result;
+		if ((opt & option_typed) != 0 && Variant2TypedArray(isolate, const_cast<VARIANT&>(v), false, result)) return result;
+		return Variant2Array(isolate, v);
+	}
+	if (const VarConv *conv = VarConvGet(v.vt)) return conv->to_value(isolate, v);
+	bool by_ref = (v.vt & VT_BYREF) != 0;
+	switch (v.vt & VT_TYPEMASK) {
 	case VT_NULL:
 		return Null(isolate);
-	case VT_I1:
-	case VT_I2:
-	case VT_I4:
-	case VT_INT:
-		return Int32::New(isolate, by_ref ? *v.plVal : v.lVal);
-	case VT_UI1:
-	case VT_UI2:
-	case VT_UI4:
-	case VT_UINT:
-		return Uint32::New(isolate, by_ref ? *v.pulVal : v.ulVal);
-	case VT_R4:
-		return Number::New(isolate, by_ref ? *v.pfltVal : v.fltVal);
-	case VT_R8:
-		return Number::New(isolate, by_ref ? *v.pdblVal : v.dblVal);
-	case VT_DATE:
-		return Date::New(isolate, by_ref ? *v.pdate : v.date);
-	case VT_BOOL:
-		return Boolean::New(isolate, (by_ref ? *v.pboolVal : v.boolVal) == VARIANT_TRUE);
 	case VT_DISPATCH: {
 		IDispatch *disp = (by_ref ? *v.ppdispVal : v.pdispVal);
 		if (!disp) return Null(isolate);
@@ -121,47 +576,39 @@ Local<Value> Variant2Value(Isolate *isolate, const VARIANT &v, bool allow_disp)
         if (by_ref && v.pbstrVal == nullptr) {
           return String::Empty(isolate);
         }
-        return String::NewFromTwoByte(isolate, (uint16_t*)(by_ref ? *v.pbstrVal : v.bstrVal));
+        return Bstr2String(isolate, by_ref ? *v.pbstrVal : v.bstrVal);
     }
 	case VT_VARIANT: 
-		if (v.pvarVal) return Variant2Value(isolate, *v.pvarVal, allow_disp);
+		if (v.pvarVal) return Variant2Value(isolate, *v.pvarVal, allow_disp, opt);
 	}
 	return Undefined(isolate);
 }
 
 Local<Value> Variant2String(Isolate *isolate, const VARIANT &v) {
 	char buf[256] = {};
-	VARTYPE vt = (v.vt & VT_TYPEMASK);
-	bool by_ref = (v.vt & VT_BYREF) != 0;
-	switch (vt) {
+	const VarConv *conv = VarConvGet(v.vt);
+	if (conv && conv->kind == VarConv::kind_int) sprintf_s(buf, "%lld", conv->to_int(v));
+	else if (conv && conv->kind == VarConv::kind_real) sprintf_s(buf, "%f", conv->to_double(v));
+
+	// Arrays have no table entry, they are converted by system as other types without own text
+	else if ((v.vt & VT_ARRAY) != 0) {
+		CComVariant tmp;
+		if (SUCCEEDED(VariantChangeType(&tmp, &v, 0, VT_BSTR)) && tmp.vt == VT_BSTR && tmp.bstrVal != nullptr) {
+			return Bstr2StringMove(isolate, tmp.bstrVal);
+		}
+	}
+	else switch (v.vt & VT_TYPEMASK) {
 	case VT_EMPTY:
 		strcpy(buf, "EMPTY");
 		break;
 	case VT_NULL:
 		strcpy(buf, "NULL");
 		break;
-	case VT_I1:
-	case VT_I2:
-	case VT_I4:
-	case VT_INT:
-		sprintf_s(buf, "%i", (int)(by_ref ? *v.plVal : v.lVal));
-		break;
-	case VT_UI1:
-	case VT_UI2:
-	case VT_UI4:
-	case VT_UINT:
-		sprintf_s(buf, "%u", (unsigned int)(by_ref ? *v.pulVal : v.ulVal));
-		break;
-	case VT_R4:
-		sprintf_s(buf, "%f", (double)(by_ref ? *v.pfltVal : v.fltVal));
-		break;
-	case VT_R8:
-		sprintf_s(buf, "%f", (double)(by_ref ? *v.pdblVal : v.dblVal));
-		break;
 	case VT_DATE:
-		return Date::New(isolate, by_ref ? *v.pdate : v.date);
+		return conv->to_value(isolate, v);
 	case VT_BOOL:
-		strcpy(buf, ((by_ref ? *v.pboolVal : v.boolVal) == VARIANT_TRUE) ? "true" : "false");
+		strcpy(buf, conv->to_int(v) ? "true" : "false");
+		break;
 	case VT_DISPATCH:
 		strcpy(buf, "[Dispatch]");
 		break;
@@ -173,14 +620,134 @@ Local<Value> Variant2String(Isolate *isolate, const VARIANT &v) {
 		break;
 	default:
 		CComVariant tmp;
-		if (SUCCEEDED(VariantChangeType(&tmp, &v, 0, VT_BSTR)) && tmp.vt == VT_BSTR && v.bstrVal != nullptr) {
-			return String::NewFromTwoByte(isolate, (uint16_t*)v.bstrVal);
+		if (SUCCEEDED(VariantChangeType(&tmp, &v, 0, VT_BSTR)) && tmp.vt == VT_BSTR && tmp.bstrVal != nullptr) {
+			return Bstr2StringMove(isolate, tmp.bstrVal);
 		}
 	}
 	return String::NewFromUtf8(isolate, buf, String::kNormalString);
 }
 
-void Value2Variant(Isolate *isolate, Local<Value> &val, VARIANT &var) {
+// One pass over nested arrays: checks rectangular shape, finds items kind and stores items in SAFEARRAY order
+enum { array_item_number = 1, array_item_string = 2, array_item_other = 4 };
+
+static bool ArrayScan(const Local<Array> &arr, const std::vector<uint32_t> &dims, size_t dim, size_t offset, size_t stride, std::vector<Local<Value>> &items, int &kinds) {
+	uint32_t cnt = arr->Length();
+	if (cnt != dims[dim]) return false;
+	bool last = (dim + 1 == dims.size());
+	for (uint32_t i = 0; i < cnt; i++) {
+		Local<Value> item = arr->Get(i);
+		size_t pos = offset + i * stride;
+		if (!last) {
+			if (!item->IsArray()) return false;
+			if (!ArrayScan(Local<Array>::Cast(item), dims, dim + 1, pos, stride * cnt, items, kinds)) return false;
+			continue;
+		}
+		if (item->IsArray()) return false;
+		if (item->IsNumber()) kinds |= array_item_number;
+		else if (item->IsString()) kinds |= array_item_string;
+		else kinds |= array_item_other;
+		items[pos] = item;
+	}
+	return true;
+}
+
+bool Array2Variant(Isolate *isolate, const Local<Array> &arr, VARIANT &var, int opt) {
+
+	// Dimensions are taken from first items, left-most index changes fastest in memory
+	std::vector<uint32_t> dims;
+	size_t total = 1;
+	for (Local<Array> dim_arr = arr; ; ) {
+		uint32_t cnt = dim_arr->Length();
+		dims.push_back(cnt);
+		total *= cnt;
+		if (cnt == 0 || dims.size() >= 32) break;
+		Local<Value> first = dim_arr->Get(0);
+		if (!first->IsArray()) break;
+		dim_arr = Local<Array>::Cast(first);
+	}
+	int kinds = 0;
+	std::vector<Local<Value>> items(total);
+	if (!ArrayScan(arr, dims, 0, 0, 1, items, kinds)) {
+
+		// Jagged array is passed as vector of variants, nested arrays are converted separately
+		dims.resize(1);
+		items.resize(dims[0]);
+		for (uint32_t i = 0; i < dims[0]; i++) items[i] = arr->Get(i);
+		kinds = array_item_other;
+	}
+
+	VARTYPE vt = VT_VARIANT;
+	if ((opt & option_array_variant) == 0) {
+		if (kinds == array_item_number) vt = VT_R8;
+		else if (kinds == array_item_string) vt = VT_BSTR;
+	}
+	std::vector<SAFEARRAYBOUND> bounds(dims.size());
+	for (size_t i = 0; i < dims.size(); i++) {
+		bounds[i].cElements = dims[i];
+		bounds[i].lLbound = 0;
+	}
+	SAFEARRAY *varr = SafeArrayCreate(vt, (UINT)dims.size(), &bounds[0]);
+	if (!varr) return false;
+	BYTE *data;
+	if FAILED(SafeArrayAccessData(varr, (void**)&data)) {
+		SafeArrayDestroy(varr);
+		return false;
+	}
+	for (size_t i = 0; i < items.size(); i++) {
+		Local<Value> &item = items[i];
+		switch (vt) {
+		case VT_R8:
+			((DOUBLE*)data)[i] = item->NumberValue();
+			break;
+		case VT_BSTR:
+			((BSTR*)data)[i] = Value2Bstr(item);
+			break;
+		default:
+			Value2Variant(isolate, item, ((VARIANT*)data)[i], opt);
+		}
+	}
+	SafeArrayUnaccessData(varr);
+	var.vt = VT_ARRAY | vt;
+	var.parray = varr;
+	return true;
+}
+
+#ifdef HAS_BIGINT
+// Smallest exact type: VT_I8, VT_UI8 or 96-bit VT_DECIMAL, larger values are passed as strings
+static void BigInt2Variant(const Local<BigInt> &val, VARIANT &var) {
+	bool lossless;
+	int64_t i64 = val->Int64Value(&lossless);
+	if (lossless) {
+		var.vt = VT_I8;
+		var.llVal = i64;
+		return;
+	}
+	uint64_t u64 = val->Uint64Value(&lossless);
+	if (lossless) {
+		var.vt = VT_UI8;
+		var.ullVal = u64;
+		return;
+	}
+	if (val->WordCount() <= 2) {
+		int sign = 0, cnt = 2;
+		uint64_t words[2] = { 0, 0 };
+		val->ToWordsArray(&sign, &cnt, words);
+		if ((words[1] >> 32) == 0) {
+			DECIMAL &dec = var.decVal;
+			dec.scale = 0;
+			dec.sign = sign ? DECIMAL_NEG : 0;
+			dec.Hi32 = (ULONG)words[1];
+			dec.Lo64 = words[0];
+			var.vt = VT_DECIMAL;	// overlaps DECIMAL reserved field
+			return;
+		}
+	}
+	var.vt = VT_BSTR;
+	var.bstrVal = Value2Bstr(val);
+}
+#endif
+
+void Value2Variant(Isolate *isolate, Local<Value> &val, VARIANT &var, int opt) {
 	if (val.IsEmpty() || val->IsUndefined()) {
 		var.vt = VT_EMPTY;
 	}
@@ -201,12 +768,23 @@ void Value2Variant(Isolate *isolate, Local<Value> &val, VARIANT &var) {
 	}
 	else if (val->IsDate()) {
 		var.vt = VT_DATE;
-		var.date = val->NumberValue();
+		var.date = Time2OleDate(val->NumberValue());
 	}
 	else if (val->IsBoolean()) {
 		var.vt = VT_BOOL;
 		var.boolVal = val->BooleanValue() ? VARIANT_TRUE : VARIANT_FALSE;
 	}
+#ifdef HAS_BIGINT
+	else if (val->IsBigInt()) {
+		BigInt2Variant(Local<BigInt>::Cast(val), var);
+	}
+#endif
+	else if ((val->IsArrayBufferView() || val->IsArrayBuffer()) && TypedArray2Variant(isolate, val, var)) {
+		// Typed arrays and buffers are passed as homogeneous SAFEARRAY
+	}
+	else if (val->IsArray() && (opt & option_array_ref) == 0 && Array2Variant(isolate, Local<Array>::Cast(val), var, opt)) {
+		// Arrays are passed by value, nested arrays as multidimensional SAFEARRAY
+	}
 	else if (val->IsObject()) {
 		Local<Object> obj = val->ToObject();
 		if (!DispObject::GetValueOf(isolate, obj, var)) {
@@ -216,9 +794,8 @@ void Value2Variant(Isolate *isolate, Local<Value> &val, VARIANT &var) {
 		}
 	}
 	else {
-		String::Value str(val);
 		var.vt = VT_BSTR;
-		var.bstrVal = (str.length() > 0) ? SysAllocString((LPOLESTR)*str) : 0;
+		var.bstrVal = Value2Bstr(val);
 	}
 }
 
@@ -314,27 +891,33 @@ HRESULT STDMETHODCALLTYPE DispEnumImpl::Invoke(DISPID dispIdMember, REFIID riid,
 
 HRESULT STDMETHODCALLTYPE DispObjectImpl::GetIDsOfNames(REFIID riid, LPOLESTR *rgszNames, UINT cNames, LCID lcid, DISPID *rgDispId) {
 	if (cNames != 1 || !rgszNames[0]) return DISP_E_UNKNOWNNAME;
-	std::wstring name(rgszNames[0]);
-	name_ptr &ptr = names[name];
-	if (!ptr) {
-		ptr.reset(new name_t(dispid_next++, name));
-		index.insert(index_t::value_type(ptr->dispid, ptr));
+	LPOLESTR name = rgszNames[0];
+	const DISPID *ptr = names.find(name);
+	if (ptr) {
+		*rgDispId = *ptr;
+		return S_OK;
 	}
-	*rgDispId = ptr->dispid;
+	DISPID dispid = dispid_next++;
+	names[name] = dispid;
+	name_t &info = index[dispid];
+	info.dispid = dispid;
+	info.name = name;
+	*rgDispId = dispid;
 	return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE DispObjectImpl::Invoke(DISPID dispIdMember, REFIID riid, LCID lcid, WORD wFlags, DISPPARAMS *pDispParams, VARIANT *pVarResult, EXCEPINFO *pExcepInfo, UINT *puArgErr) {
 	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope scope(isolate);
 	Local<Object> self = obj.Get(isolate);
+	Context::Scope context_scope(self->CreationContext());	// may be called from message pump
 	Local<Value> name, val, ret;
 
 	// Prepare name by member id
 	if (dispIdMember != DISPID_VALUE) {
-		index_t::const_iterator p = index.find(dispIdMember);
-		if (p == index.end()) return DISP_E_MEMBERNOTFOUND;
-		name_t &info = *p->second;
-		name = String::NewFromTwoByte(isolate, (uint16_t*)info.name.c_str());
+		const name_t *info = index.find(dispIdMember);
+		if (!info) return DISP_E_MEMBERNOTFOUND;
+		name = String::NewFromTwoByte(isolate, (uint16_t*)info->name.c_str(), String::kInternalizedString, (int)info->name.length());
 	}
 
 	// Set property value
@@ -417,7 +1000,7 @@ HRESULT STDMETHODCALLTYPE DispObjectImpl::Invoke(DISPID dispIdMember, REFIID rii
 
 	// Store result
 	if (pVarResult) {
-		Value2Variant(isolate, ret, *pVarResult);
+		Value2Variant(isolate, ret, *pVarResult, option_array_ref);
 	}
 	return S_OK;
 }
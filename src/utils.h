@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "flatmap.h"
+
 //-------------------------------------------------------------------------------------------------------
 
 #ifdef _DEBUG
@@ -209,43 +211,70 @@ inline HRESULT DispInvoke(IDispatch *disp, LPOLESTR name, UINT argcnt = 0, VARIA
 
 //-------------------------------------------------------------------------------------------------------
 
+#if V8_MAJOR_VERSION > 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION >= 7)
+#define HAS_BIGINT
+#endif
+
+// JS representation of 64-bit integers and decimals, set by winax.configure
+extern bool var_bigint;				// VT_I8 and VT_UI8 as BigInt, if supported by V8
+extern bool var_decimal_string;		// VT_CY and VT_DECIMAL as exact decimal strings
+extern bool var_date_utc;			// VT_DATE values are UTC instead of local time
+
+// OLE automation date (days since 1899-12-30) and JS time (milliseconds since 1970-01-01 UTC)
+double OleDate2Time(DATE date);
+DATE Time2OleDate(double time);
+
+// Scalar conversions generated per VARTYPE, separate entries for by-ref variants
+struct VarConv {
+	enum kind_t { kind_none = 0, kind_int, kind_real, kind_int64, kind_other };
+	kind_t kind;
+	LONGLONG (*to_int)(const VARIANT &v);
+	double (*to_double)(const VARIANT &v);
+	Local<Value> (*to_value)(Isolate *isolate, const VARIANT &v);
+};
+
+extern const VarConv var_conv[2][VT_UINT + 1];
+
+inline const VarConv *VarConvGet(VARTYPE vt) {
+	VARTYPE type = (vt & VT_TYPEMASK);
+	if (type > VT_UINT || (vt & VT_ARRAY) != 0) return nullptr;
+	const VarConv *conv = &var_conv[(vt & VT_BYREF) ? 1 : 0][type];
+	return (conv->kind != VarConv::kind_none) ? conv : nullptr;
+}
+
 template<typename INTTYPE>
 inline INTTYPE Variant2Int(const VARIANT &v, const INTTYPE def) {
-    VARTYPE vt = (v.vt & VT_TYPEMASK);
-	bool by_ref = (v.vt & VT_BYREF) != 0;
-    switch (vt) {
-    case VT_EMPTY:
-    case VT_NULL:
-        return def;
-    case VT_I1:
-    case VT_I2:
-    case VT_I4:
-    case VT_INT:
-        return (INTTYPE)(by_ref ? *v.plVal : v.lVal);
-    case VT_UI1:
-    case VT_UI2:
-    case VT_UI4:
-    case VT_UINT:
-        return (INTTYPE)(by_ref ? *v.pulVal : v.ulVal);
-    case VT_R4:
-        return (INTTYPE)(by_ref ? *v.pfltVal : v.fltVal);
-    case VT_R8:
-        return (INTTYPE)(by_ref ? *v.pdblVal : v.dblVal);
-    case VT_DATE:
-        return (INTTYPE)(by_ref ? *v.pdate : v.date);
-    case VT_BOOL:
-        return (v.boolVal == VARIANT_TRUE) ? 1 : 0;
+	if (const VarConv *conv = VarConvGet(v.vt)) return (INTTYPE)conv->to_int(v);
+	switch (v.vt & VT_TYPEMASK) {
+	case VT_EMPTY:
+	case VT_NULL:
+		return def;
 	case VT_VARIANT:
 		if (v.pvarVal) return Variant2Int<INTTYPE>(*v.pvarVal, def);
 	}
-    VARIANT dst;
-    return SUCCEEDED(VariantChangeType(&dst, &v, 0, VT_INT)) ? (INTTYPE)dst.intVal : def;
+	VARIANT dst;
+	return SUCCEEDED(VariantChangeType(&dst, &v, 0, VT_INT)) ? (INTTYPE)dst.intVal : def;
+}
+
+// Types converted to JS numbers without precision loss
+inline bool Variant2Number(const VARIANT &v, double &value) {
+	const VarConv *conv = VarConvGet(v.vt);
+	if (!conv || conv->kind > VarConv::kind_real) return false;
+	value = conv->to_double(v);
+	return true;
 }
 
+Local<String> Bstr2String(Isolate *isolate, BSTR bstr, bool internalize = false);
+Local<String> Bstr2StringMove(Isolate *isolate, BSTR &bstr);
+BSTR Value2Bstr(const Local<Value> &val);
 Local<Value> Variant2Array(Isolate *isolate, const VARIANT &v);
-Local<Value> Variant2Value(Isolate *isolate, const VARIANT &v, bool allow_disp = false);
+Local<Value> Variant2Value(Isolate *isolate, const VARIANT &v, bool allow_disp = false, int opt = 0);
+Local<Value> Variant2Result(Isolate *isolate, VARIANT &v, int opt);
+bool Variant2TypedArray(Isolate *isolate, VARIANT &v, bool move, Local<Value> &result);
+bool TypedArray2Variant(Isolate *isolate, const Local<Value> &val, VARIANT &var);
 Local<Value> Variant2String(Isolate *isolate, const VARIANT &v);
-void Value2Variant(Isolate *isolate, Local<Value> &val, VARIANT &var);
+void Value2Variant(Isolate *isolate, Local<Value> &val, VARIANT &var, int opt = 0);
+bool Array2Variant(Isolate *isolate, const Local<Array> &arr, VARIANT &var, int opt);
 bool VariantDispGet(VARIANT *v, IDispatch **disp);
 bool UnknownDispGet(IUnknown *unk, IDispatch **disp);
 
@@ -259,17 +288,106 @@ inline bool v8val2bool(const Local<Value> &v, bool def) {
     return def;
 }
 
+// Well-known symbol (Symbol.iterator, Symbol.asyncIterator) if the runtime has it
+inline bool GetWellKnownSymbol(Isolate *isolate, const char *name, Local<Symbol> &result) {
+	Local<Value> ctor = isolate->GetCurrentContext()->Global()->Get(String::NewFromUtf8(isolate, "Symbol"));
+	if (ctor.IsEmpty() || !ctor->IsFunction()) return false;
+	Local<Value> sym = ctor->ToObject()->Get(String::NewFromUtf8(isolate, name));
+	if (sym.IsEmpty() || !sym->IsSymbol()) return false;
+	result = Local<Symbol>::Cast(sym);
+	return true;
+}
+
 //-------------------------------------------------------------------------------------------------------
 
+// Property name copied to stack buffer, long names only use heap
+class NameBuffer {
+public:
+	NameBuffer(const Local<String> &str) {
+		int len = str.IsEmpty() ? 0 : str->Length();
+		if (len < (int)(sizeof(buf) / sizeof(buf[0]))) ptr = buf;
+		else {
+			heap.resize(len + 1);
+			ptr = &heap[0];
+		}
+		if (len > 0) str->Write((uint16_t*)ptr, 0, len, String::NO_NULL_TERMINATION);
+		ptr[len] = 0;
+	}
+	inline operator LPOLESTR() { return ptr; }
+
+private:
+	OLECHAR buf[64];
+	std::vector<OLECHAR> heap;
+	LPOLESTR ptr;
+};
+
+// Arguments storage, no heap allocation while arguments fit in inline buffer
+class VarBuffer {
+public:
+	enum { inline_size = 8 };
+	inline VarBuffer() : ptr(buf), count(0), capacity(inline_size) {}
+	inline ~VarBuffer() {
+		resize(0);
+		if (ptr != buf) free(ptr);
+	}
+
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	inline VARIANT &operator[](size_t i) { return ptr[i]; }
+	inline VARIANT &front() { return ptr[0]; }
+	inline VARIANT &append() {
+		resize(count + 1);
+		return ptr[count - 1];
+	}
+
+	void resize(size_t cnt) {
+		if (cnt > capacity) grow(cnt);
+		for (size_t i = cnt; i < count; i++) Clear(ptr[i]);
+		for (size_t i = count; i < cnt; i++) ptr[i].vt = VT_EMPTY;
+		count = cnt;
+	}
+
+	void assign(VarBuffer &src) {
+		resize(0);
+		resize(src.count);
+		for (size_t i = 0; i < count; i++) VariantCopy(&ptr[i], &src.ptr[i]);
+	}
+
+	// Scalars and references own nothing
+	static inline void Clear(VARIANT &v) {
+		if (v.vt == VT_BSTR) SysFreeString(v.bstrVal);
+		else if ((v.vt & VT_BYREF) == 0 && (v.vt == VT_DISPATCH || v.vt == VT_UNKNOWN || v.vt == VT_VARIANT || v.vt == VT_RECORD || v.vt == VT_DECIMAL || (v.vt & VT_ARRAY) != 0)) VariantClear(&v);
+		v.vt = VT_EMPTY;
+	}
+
+private:
+	VARIANT buf[inline_size];
+	VARIANT *ptr;
+	size_t count, capacity;
+
+	// Fails as std::vector did, buffer is left unchanged
+	void grow(size_t cnt) {
+		VARIANT *p = (cnt <= SIZE_MAX / sizeof(VARIANT)) ? (VARIANT*)malloc(cnt * sizeof(VARIANT)) : nullptr;
+		if (!p) throw std::bad_alloc();
+		if (count > 0) memcpy(p, ptr, count * sizeof(VARIANT));
+		if (ptr != buf) free(ptr);
+		ptr = p;
+		capacity = cnt;
+	}
+
+	VarBuffer(const VarBuffer&);
+	VarBuffer &operator=(const VarBuffer&);
+};
+
 class VarArguments {
 public:
-	std::vector<CComVariant> items;
+	VarBuffer items;
 	VarArguments() {}
-    VarArguments(Isolate *isolate, Local<Value> value) : isolate_(isolate) {
+    VarArguments(Isolate *isolate, Local<Value> value, int opt = 0) : isolate_(isolate) {
 		items.resize(1);
-		Value2Variant(isolate, value, items[0]);
+		Value2Variant(isolate, value, items[0], opt);
 	}
-    VarArguments(Isolate *isolate, const FunctionCallbackInfo<Value> &args) : isolate_(isolate) {
+    VarArguments(Isolate *isolate, const FunctionCallbackInfo<Value> &args, int opt = 0) : isolate_(isolate) {
 		int argcnt = args.Length();
         if (argcnt == 2 && args[0]->IsArray() && args[1]->IsArray()) {
           real_args = args[0].As<v8::Array>();
@@ -277,17 +395,17 @@ public:
           argcnt = real_args->Length();
           items.resize(argcnt);
           for (int i = 0; i < argcnt; i++) {
-            Value2Variant(isolate, real_args->Get(argcnt - i - 1), items[i]);
+            Value2Variant(isolate, real_args->Get(argcnt - i - 1), items[i], opt);
           }
-          ref_items = items;
+          ref_items.assign(items);
           int ref_count = ref_indexes->Length();
           for (int i = 0; i < ref_count; ++i) {
             if (ref_indexes->Get(i)->IsInt32()) {
               int index = ref_indexes->Get(i)->Int32Value();
               if (index >= 0 && index < argcnt) {
                 indexes.push_back(index);
-                CComVariant& item = items[argcnt - index - 1];
-                CComVariant& ref_item = ref_items[argcnt - index - 1];
+                VARIANT& item = items[argcnt - index - 1];
+                VARIANT& ref_item = ref_items[argcnt - index - 1];
                 switch (item.vt) {
                 case VT_BOOL:
                   item.vt |= VT_BYREF;
@@ -326,7 +444,7 @@ public:
         } else {
           items.resize(argcnt);
           for (int i = 0; i < argcnt; i++)
-            Value2Variant(isolate, args[argcnt - i - 1], items[i]);
+            Value2Variant(isolate, args[argcnt - i - 1], items[i], opt);
         }
 		
 	}
@@ -341,7 +459,7 @@ public:
 private:
     Isolate *isolate_;
     v8::Local<v8::Array> real_args;
-    std::vector<CComVariant> ref_items;
+    VarBuffer ref_items;
     std::vector<int> indexes;
 };
 
@@ -414,11 +532,10 @@ public:
 	struct name_t { 
 		DISPID dispid;
 		std::wstring name;
-		inline name_t(DISPID id, const std::wstring &nm): dispid(id), name(nm) {}
+		inline name_t() : dispid(DISPID_UNKNOWN) {}
 	};
-	typedef std::shared_ptr<name_t> name_ptr;
-	typedef std::map<std::wstring, name_ptr> names_t;
-	typedef std::map<DISPID, name_ptr> index_t;
+	typedef FlatMap<std::wstring, DISPID> names_t;
+	typedef FlatMap<DISPID, name_t> index_t;
 	DISPID dispid_next;
 	names_t names;
 	index_t index;
@@ -56,6 +56,22 @@ describe("ADODB.Connection", function() {
         }
     });
 
+    it("fetch rows", function() {
+        if (con) {
+            var rs = con.Execute("Select * from " + filename); 
+            var rows = winax.fetchRows(rs, { maxRows: 2 });
+            assert.equal(rows.length, 2);
+            assert.equal(rows[0].length, 4);
+            rows = rows.concat(winax.fetchRows(rs));
+            assert.equal(rows.length, reccnt);
+            assert.equal(winax.fetchRows(rs).length, 0);
+            rs.MoveFirst();
+            var cols = winax.fetchRows(rs, { columns: ['Name', 'Zip'], columnar: true });
+            assert.equal(cols.length, 2);
+            assert.equal(cols[1].length, reccnt);
+        }
+    });
+
     it("loop by records", function() {
         if (rs && fields) {
             var cnt = 0;
@@ -74,6 +90,174 @@ describe("ADODB.Connection", function() {
     
 });
 
+describe("ADODB.Recordset", function() {
+
+    it("scalar field types", function() {
+        var mrs = new ActiveXObject("ADODB.Recordset");
+        var types = [
+            ['i1', 16, -5], ['i2', 2, -1234], ['i4', 3, -123456789], ['ui1', 17, 200],
+            ['ui2', 18, 65000], ['ui4', 19, 4000000000], ['r4', 4, 0.5], ['r8', 5, -1.25],
+            ['cy', 6, 12.5], ['bool', 11, true]
+        ];
+        types.forEach(function(t) { mrs.Fields.Append(t[0], t[1]); });
+        mrs.Open();
+        mrs.AddNew();
+        types.forEach(function(t) { mrs.Fields(t[0]).Value = t[2]; });
+        mrs.Update();
+        mrs.MoveFirst();
+        types.forEach(function(t) { assert.strictEqual(mrs.Fields(t[0]).Value, t[2], t[0]); });
+        var row = winax.fetchRows(mrs, { maxRows: 1 })[0];
+        types.forEach(function(t, i) { assert.strictEqual(row[i], t[2], t[0]); });
+        mrs.Close();
+    });
+
+    it("64-bit integers and currency without precision loss", function() {
+        var mrs = new ActiveXObject("ADODB.Recordset");
+        mrs.Fields.Append('i8', 20);    // adBigInt
+        mrs.Fields.Append('cy', 6);     // adCurrency
+        mrs.Open();
+        mrs.AddNew();
+        mrs.Fields('i8').Value = (typeof BigInt !== 'undefined') ? BigInt('9007199254740993') : 123;
+        mrs.Fields('cy').Value = '1234567890123.4567';
+        mrs.Update();
+        mrs.MoveFirst();
+        if (typeof BigInt !== 'undefined') assert.strictEqual(mrs.Fields('i8').Value, BigInt('9007199254740993'));
+        winax.configure({ decimals: 'string' });
+        try {
+            assert.strictEqual(winax.configure().decimals, 'string');
+            assert.strictEqual(mrs.Fields('cy').Value, '1234567890123.4567');
+        }
+        finally {
+            winax.configure({ decimals: 'number' });
+        }
+        mrs.Close();
+    });
+
+});
+
+describe("Collections", function() {
+
+    it("iterate fields", function() {
+        var mrs = new ActiveXObject("ADODB.Recordset");
+        var names = [];
+        for (var i = 0; i < 20; i++) {
+            names.push('f' + i);
+            mrs.Fields.Append('f' + i, 3);
+        }
+        var found = [];
+        for (var field of mrs.Fields) found.push(field.Name);
+        assert.deepEqual(found, names);
+    });
+
+    it("iterate fields asynchronously", function() {
+        var mrs = new ActiveXObject("ADODB.Recordset");
+        if (typeof Symbol.asyncIterator === 'undefined') return this.skip();
+        mrs.Fields.Append('a', 3);
+        mrs.Fields.Append('b', 3);
+        var it = mrs.Fields[Symbol.asyncIterator](), found = [];
+        function step() {
+            return it.next().then(function(res) {
+                if (res.done) return;
+                found.push(res.value.Name);
+                return step();
+            });
+        }
+        return step().then(function() { assert.deepEqual(found, ['a', 'b']); });
+    });
+
+});
+
+describe("OLE dates", function() {
+
+    // OLE date: days since 1899-12-30, for negative values the fraction is time of day counted forward
+    var dates = [
+        [0, '1899-12-30T00:00:00.000Z'],
+        [2.75, '1900-01-01T18:00:00.000Z'],
+        [-1.25, '1899-12-29T06:00:00.000Z'],
+        [-36522.5, '1800-01-01T12:00:00.000Z'],
+        [25569.5, '1970-01-01T12:00:00.000Z'],
+        [44197 + 86399 / 86400, '2021-01-01T23:59:59.000Z']
+    ];
+
+    it("conversion table", function() {
+        var mrs = new ActiveXObject("ADODB.Recordset");
+        mrs.Fields.Append('d', 7);      // adDate
+        mrs.Open();
+        dates.forEach(function(d) {
+            mrs.AddNew();
+            mrs.Fields('d').Value = d[0];
+        });
+        mrs.Update();
+        winax.configure({ dates: 'utc' });
+        try {
+            mrs.MoveFirst();
+            dates.forEach(function(d) {
+                assert.strictEqual(mrs.Fields('d').Value.toISOString(), d[1]);
+                mrs.MoveNext();
+            });
+            mrs.MoveFirst();
+            var column = winax.fetchRows(mrs, { columnar: true })[0];
+            assert.deepEqual(column.map(function(d) { return d.toISOString(); }), dates.map(function(d) { return d[1]; }));
+
+            // JS dates are stored as the same OLE dates
+            mrs.MoveFirst();
+            dates.forEach(function(d) {
+                mrs.Fields('d').Value = new Date(d[1]);
+                assert.strictEqual(mrs.Fields('d').Value.toISOString(), d[1]);
+                mrs.MoveNext();
+            });
+        }
+        finally {
+            winax.configure({ dates: 'local' });
+        }
+        mrs.Close();
+    });
+
+});
+
+describe("ADODB.Stream", function() {
+
+    it("binary data as Buffer", function() {
+        var stream = new ActiveXObject("ADODB.Stream", { typedArrays: true });
+        stream.Type = 1; // adTypeBinary
+        stream.Open();
+        stream.Write(new Buffer([1, 2, 3]));
+        stream.Position = 0;
+        var buf = stream.Read();
+        assert(Buffer.isBuffer(buf));
+        assert.deepEqual(Array.prototype.slice.call(buf), [1, 2, 3]);
+        stream.Close();
+    });
+
+});
+
+describe("Dedicated apartment", function() {
+
+    it("query on apartment connection", function() {
+        var acon = new ActiveXObject("ADODB.Connection", { apartment: 'sta' });
+        acon.Open(constr, "", "");
+        return winax.callAsync(acon, 'Execute', "Select * from " + filename).then(function(ars) {
+            return winax.getAsync(ars, 'EOF');
+        }).then(function(eof) {
+            assert.equal(eof, false);
+            acon.Close();
+        });
+    });
+
+    it("objects returned synchronously stay in apartment", function() {
+        var acon = new ActiveXObject("ADODB.Connection", { apartment: 'sta' });
+        acon.Open(constr, "", "");
+        var ars = acon.Execute("Select * from " + filename);
+        var jobs = winax.stats().apartments.jobs;
+        return winax.getAsync(ars, 'EOF').then(function(eof) {
+            assert.equal(eof, false);
+            assert(winax.stats().apartments.jobs > jobs);
+            acon.Close();
+        });
+    });
+
+});
+
 describe("Release objects", function() {
     
     it("release", function() {
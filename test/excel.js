@@ -1,4 +1,4 @@
-require('../activex');
+var winax = require('../activex');
 
 var path = require('path'); 
 const assert = require('assert');
@@ -15,7 +15,8 @@ var com_obj, js_obj = {
     obj: { params: test_value },
     arr: [ test_value, test_value, test_value ],
     func: function(v) { return v*2; },
-    func2: function(obj) { return obj.text; }
+    func2: function(obj) { return obj.text; },
+    echo: function(v) { return v; }
 };
 
 describe("COM from JS object", function() {
@@ -70,6 +71,102 @@ describe("COM from JS object", function() {
     it("call method with object argument", function() {
         if (com_obj) assert.equal(com_obj.func2(com_obj), js_obj.text);
     });
+
+    it("64-bit integers as BigInt", function() {
+        if (typeof BigInt === 'undefined') return this.skip();
+        if (com_obj) ['9007199254740993', '-9223372036854775808', '18446744073709551615'].forEach(function(text) {
+            assert.strictEqual(com_obj.echo(BigInt(text)), BigInt(text));
+        });
+    });
+
+    it("96-bit BigInt as decimal string", function() {
+        if (typeof BigInt === 'undefined') return this.skip();
+        if (com_obj) {
+            winax.configure({ decimals: 'string' });
+            var text = '-79228162514264337593543950335', result = com_obj.echo(BigInt(text));
+            winax.configure({ decimals: 'number' });
+            assert.strictEqual(result, text);
+        }
+    });
+
+    it("dates round trip", function() {
+        if (com_obj) ['local', 'utc'].forEach(function(mode) {
+            winax.configure({ dates: mode });
+            var d = new Date(1850, 6, 14, 10, 30, 15, 250);
+            assert.strictEqual(com_obj.echo(d).getTime(), d.getTime());
+        });
+        winax.configure({ dates: 'local' });
+    });
+
+    it("call method asynchronously", function() {
+        if (com_obj) return winax.callAsync(com_obj, 'func', test_func_arg).then(function(result) {
+            assert.equal(result, js_obj.func(test_func_arg));
+        });
+    });
+
+    it("nextTick queued by async result handler", function() {
+        if (com_obj) return winax.callAsync(com_obj, 'func', test_func_arg).then(function() {
+            return new Promise(function(resolve) { process.nextTick(resolve); });
+        });
+    });
+
+    it("batch calls", function() {
+        if (com_obj) {
+            var results = winax.batch([
+                [com_obj, 'func', test_func_arg],
+                [{}, 'func'],
+                [com_obj, 'text=', test_value3],
+                [com_obj, 'text']
+            ]);
+            assert.equal(results.length, 4);
+            assert.equal(results[0], js_obj.func(test_func_arg));
+            assert(results[1] instanceof Error);
+            assert.equal(typeof results[1].hresult, 'number');
+            assert.equal(results[3], test_value3);
+        }
+    });
+
+    it("batch calls asynchronously", function() {
+        if (com_obj) return winax.batch([[com_obj, 'func', 1], [com_obj, 'func', 2]], { async: true }).then(function(results) {
+            assert.deepEqual(results, [js_obj.func(1), js_obj.func(2)]);
+        });
+    });
+
+    it("profile calls", function() {
+        if (com_obj) {
+            winax.configure({ profile: true });
+            winax.stats(true);
+            com_obj.func(1);
+            com_obj.func(2);
+            var members = JSON.parse(JSON.stringify(winax.stats(true).members));
+            winax.configure({ profile: false });
+            var func = members.filter(function(m) { return m.member == 'func' && m.type == 'call'; })[0];
+            assert(func);
+            assert.equal(func.count, 2);
+            assert.equal(func.failures, 0);
+            assert.equal(func.histogram.reduce(function(a, b) { return a + b; }), 2);
+            assert(func.maxTime <= func.time);
+        }
+    });
+
+    it("profile reads by valueOf", function() {
+        if (com_obj) {
+            winax.configure({ profile: true });
+            winax.stats(true);
+            assert.equal(com_obj.text.valueOf(), js_obj.text);
+            var members = JSON.parse(JSON.stringify(winax.stats(true).members));
+            winax.configure({ profile: false });
+            var text = members.filter(function(m) { return m.member == 'text' && m.type == 'get'; })[0];
+            assert(text);
+            assert(text.count >= 1);
+        }
+    });
+
+    it("read property asynchronously", function() {
+        if (com_obj) return winax.getAsync(com_obj, 'text').then(function(result) {
+            assert.equal(result, js_obj.text);
+        });
+    });
 });
 
 describe("Excel with JS object", function() {
@@ -98,6 +195,25 @@ describe("Excel with JS object", function() {
         assert.equal(val, 'test');
     });
     
+    it("range value as 2-D array", function() {
+        var wsh = wbk.Worksheets.Item(1);
+        wsh.Cells(1,1).Value = 'a';
+        wsh.Cells(1,2).Value = 'b';
+        wsh.Cells(2,1).Value = 1;
+        wsh.Cells(2,2).Value = 2.5;
+        var arr = wsh.Range('A1:B2').Value.valueOf();
+        assert.equal(arr.length, 2);
+        assert.deepEqual(arr[0], ['a', 'b']);
+        assert.deepEqual(arr[1], [1, 2.5]);
+    });
+
+    it("range value from 2-D array", function() {
+        var wsh = wbk.Worksheets.Item(1);
+        wsh.Range('A1:C2').Value = [ [ 'a', 'b', 'c' ], [ 1, 2, 3 ] ];
+        assert.equal(wsh.Cells(1,3).Value, 'c');
+        assert.equal(wsh.Cells(2,2).Value, 2);
+    });
+
     it("invoke test simple property", function() {
         if (wbk && com_obj) assert.equal(test_value3, wbk.Test(com_obj, 'text', 0, test_value3));
     });
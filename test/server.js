@@ -0,0 +1,197 @@
+var winax = require('../activex');
+
+const assert = require('assert');
+
+// DISP_E_MEMBERNOTFOUND as signed 32-bit number
+var member_not_found = 0x80020003 | 0;
+
+[false, true].forEach(function(typed) {
+
+    describe("Test server" + (typed ? " with type info" : ""), function() {
+        var child, srv;
+
+        it("create", function() {
+            child = winax.testServer({ properties: { Name: 'child', Value: 1 }, typeInfo: typed });
+            srv = winax.testServer({
+                properties: { Text: 'text', Count: 3, Child: child, Big: 2.5 },
+                methods: { Echo: null, Answer: 42 },
+                errors: { Broken: member_not_found },
+                items: [ 'a', 'b', 'c' ],
+                typeInfo: typed
+            });
+        });
+
+        it("read and write properties", function() {
+            assert.equal(srv.Text, 'text');
+            assert.equal(srv.Count, 3);
+            srv.Text = 'changed';
+            assert.equal(srv.Text, 'changed');
+        });
+
+        it("call methods", function() {
+            assert.equal(srv.Echo(5, 6), 5);
+            assert.equal(srv.Echo('str'), 'str');
+            assert.equal(srv.Answer(), 42);
+        });
+
+        it("special names in any letter case", function() {
+            assert.equal(srv.__ID, srv.__id);
+            assert.strictEqual(srv.tostring, srv.toString);
+            assert.strictEqual(srv.VALUEOF, srv.valueOf);
+        });
+
+        it("method wrappers are reused", function() {
+            assert.strictEqual(srv.Echo, srv.Echo);
+            assert.strictEqual(srv.valueOf, winax.Object.prototype.valueOf);
+            assert.strictEqual(srv.toString, child.toString);
+            var answer = srv.Answer;
+            assert.equal(answer.valueOf(), 42);
+            assert.notStrictEqual(srv.Answer, answer);
+            assert.equal(srv.Answer(), 42);
+        });
+
+        it("batch rejects member wrappers", function() {
+            var results = winax.batch([[srv.Echo, 'Text'], [srv, 'Text']]);
+            assert(results[0] instanceof Error);
+            assert.equal(results[1], srv.Text);
+        });
+
+        it("chained objects", function() {
+            assert.equal(srv.Child.Name, 'child');
+            srv.Child.Value = 2;
+            assert.equal(child.Value, 2);
+        });
+
+        it("indexed items", function() {
+            assert.equal(srv[1], 'b');
+            srv[1] = 'x';
+            assert.equal(srv[1], 'x');
+        });
+
+        it("enumerate items", function() {
+            var found = [];
+            for (var item of srv) found.push(item);
+            assert.deepEqual(found, ['a', 'x', 'c']);
+        });
+
+        it("failed call", function() {
+            assert.throws(function() { srv.Broken(); });
+        });
+
+        it("release", function() {
+            winax.release(srv, child);
+        });
+    });
+
+});
+
+describe("Test server value types", function() {
+
+    it("member added after a miss", function() {
+        var srv = winax.testServer({ properties: { Text: 'text' }, expando: { Define: true } });
+        assert.equal(srv.Later, undefined);
+        srv.Define('Later', 1);
+        assert.equal(srv.Later, 1);
+        winax.release(srv);
+    });
+
+    it("date and bool arrays as strings", function() {
+        var srv = winax.testServer({
+            properties: { Dates: [new Date(2020, 0, 1), new Date(2021, 0, 1)], Flags: [true, false] },
+            types: { Dates: 0x2007, Flags: 0x200B }     // VT_ARRAY | VT_DATE, VT_ARRAY | VT_BOOL
+        });
+        assert.equal(typeof srv.Dates.toString(), 'string');
+        assert.equal(typeof srv.Flags.toString(), 'string');
+        var dates = srv.Dates.valueOf(), flags = srv.Flags.valueOf();
+        assert.equal(dates.length, 2);
+        assert(dates[0] instanceof Date);
+        assert.deepEqual(flags, [true, false]);
+        winax.release(srv);
+    });
+
+});
+
+describe("Typed accessors", function() {
+    var srv, guid = '{6C6D1E3A-6F4B-4E59-9A55-3D2B0C1E7F01}';
+
+    it("create", function() {
+        srv = winax.testServer({ properties: { Text: 'text', Count: 3 }, methods: { Echo: null, Answer: 42 }, typeInfo: guid, eager: true });
+    });
+
+    it("simple properties are accessors", function() {
+        var names = Object.getOwnPropertyNames(srv);
+        assert(names.indexOf('Text') >= 0);
+        assert(names.indexOf('Count') >= 0);
+        assert(names.indexOf('Echo') < 0);
+        assert.equal(Object.keys(srv).indexOf('Text'), -1);
+        assert(winax.stats().templates > 0);
+    });
+
+    it("read and write through accessors", function() {
+        for (var i = 0; i < 100; i++) assert.equal(srv.Count, 3);
+        srv.Text = 'changed';
+        assert.equal(srv.Text, 'changed');
+        assert.equal(srv.text, 'changed');
+        assert.equal(srv.Echo(7), 7);
+        assert.equal(srv.Unknown, undefined);
+    });
+
+    it("template is shared by interface", function() {
+        var other = winax.testServer({ properties: { Text: 'other', Count: 5 }, methods: { Echo: null, Answer: 42 }, typeInfo: guid, eager: true });
+        assert.equal(Object.getPrototypeOf(other), Object.getPrototypeOf(srv));
+        assert(other instanceof winax.Object);
+        assert.equal(other.Count, 5);
+        winax.release(other);
+    });
+
+    it("disabled accessors", function() {
+        winax.configure({ accessors: false });
+        var plain = winax.testServer({ properties: { Text: 'plain' }, typeInfo: guid, eager: true });
+        winax.configure({ accessors: true });
+        assert.equal(Object.getOwnPropertyNames(plain).indexOf('Text'), -1);
+        assert.equal(plain.Text, 'plain');
+        winax.release(plain);
+    });
+
+    it("lazy objects do not load type info on creation", function() {
+        var lazy = winax.testServer({ properties: { Text: 'lazy', Count: 1 }, methods: { Echo: null, Answer: 42 }, typeInfo: guid });
+        assert.equal(Object.getOwnPropertyNames(lazy).indexOf('Text'), -1);
+        assert.equal(lazy.Text, 'lazy');
+        winax.release(lazy);
+    });
+
+    it("released object", function() {
+        winax.release(srv);
+        assert.throws(function() { return srv.Text; });
+    });
+});
+
+describe("Names shared by type", function() {
+
+    it("members are resolved once per type", function() {
+        var spec = { properties: { Text: 'text' }, methods: { Echo: null, Answer: 42 }, typeInfo: '{3B0E9F7C-51D2-4A8B-9C3E-7D4F2A1B6E05}' };
+        var a = winax.testServer(spec), b = winax.testServer(spec);
+        winax.stats(true);
+        for (var i = 0; i < 3; i++) [a, b].forEach(function(srv) {
+            srv.Echo(1);
+            srv.Answer();
+            assert.equal(srv.text, 'text');
+        });
+        assert.equal(winax.stats().testServer.lookups, 3);
+        winax.release(a, b);
+    });
+
+});
+
+describe("Test server latency", function() {
+
+    it("calls take configured time", function() {
+        var srv = winax.testServer({ methods: { Wait: 1 }, latency: 2000 });
+        var t = process.hrtime();
+        srv.Wait();
+        var dt = process.hrtime(t);
+        assert(dt[0] * 1e6 + dt[1] / 1e3 >= 2000);
+        winax.release(srv);
+    });
+
+});